@@ -0,0 +1,36 @@
+#include "anzu.hpp"
+#include "compiler.hpp"
+#include "parser.hpp"
+#include "runtime.hpp"
+
+namespace anzu {
+namespace {
+
+auto compile_module(const anzu_module& ast) -> std::shared_ptr<const bytecode_program>
+{
+    auto imports = parse_imports(ast);
+    return std::make_shared<const bytecode_program>(compile(ast, std::move(imports)));
+}
+
+}
+
+program::program(std::shared_ptr<const bytecode_program> prog)
+    : d_program{std::move(prog)}
+{}
+
+auto program::from_file(const std::filesystem::path& file) -> program
+{
+    return program{compile_module(parse(file))};
+}
+
+auto program::from_source(std::string source) -> program
+{
+    return program{compile_module(parse_source(std::move(source)))};
+}
+
+auto program::run(std::span<const std::string> args) const -> void
+{
+    run_program(*d_program, args);
+}
+
+}
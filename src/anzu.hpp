@@ -0,0 +1,39 @@
+#pragma once
+#include "error.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+
+// The public interface for embedding anzu in another application. Link against the anzu
+// library (static or shared) and include only this header. Errors in the program, whether
+// found while compiling or while running it, are thrown as anzu::error.
+namespace anzu {
+
+struct bytecode_program;
+
+// A compiled program. Programs are immutable once compiled, so a single program can be run
+// any number of times, including concurrently from multiple threads. Each run gets its own
+// stack and arenas, and shares the bytecode with every other run. Copies are cheap and
+// share the same bytecode.
+class program
+{
+    std::shared_ptr<const bytecode_program> d_program;
+
+    explicit program(std::shared_ptr<const bytecode_program> prog);
+
+public:
+    // Compiles the given file. Imports are resolved relative to the working directory.
+    static auto from_file(const std::filesystem::path& file) -> program;
+
+    // Compiles a program from source code held in memory
+    static auto from_source(std::string source) -> program;
+
+    // Runs the program to completion on the calling thread, with the given command line args
+    auto run(std::span<const std::string> args = {}) const -> void;
+
+    auto bytecode() const -> const bytecode_program& { return *d_program; }
+};
+
+}
@@ -3,38 +3,172 @@
 #include "compiler.hpp"
 #include "bytecode.hpp"
 #include "runtime.hpp"
+#include "stats.hpp"
+#include "bench.hpp"
+#include "server.hpp"
 #include "utility/common.hpp"
 #include "utility/memory.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <map>
+#include <optional>
 #include <set>
 #include <filesystem>
 #include <print>
+#include <vector>
 
 void print_usage()
 {
-    std::print("usage: anzu.exe <program_file> <option>\n\n");
+    std::print("usage: anzu.exe <program_file> <option> [flags] [-- args]\n");
+    std::print("       anzu.exe <socket_path> serve [flags]\n\n");
     std::print("The Anzu Programming Language\n\n");
     std::print("options:\n");
     std::print("    lex      - runs the lexer and prints the tokens for a single file\n");
     std::print("    parse    - runs the parser and prints the AST for a single file\n");
     std::print("    com      - runs the compiler and prints the bytecode\n");
     std::print("    debug    - runs the program and prints each op code executed\n");
+    std::print("    bench    - runs the program repeatedly without output and prints timing statistics\n");
+    std::print("    profile  - runs the program and prints op code and function statistics\n");
+    std::print("    sample   - runs the program and prints the source lines it spends the most time on\n");
     std::print("    run      - runs the program\n");
+    std::print("    serve    - runs a server on the given socket that caches compiled programs\n");
+    std::print("    client   - runs the program on the server given by --socket\n\n");
+    std::print("flags:\n");
+    std::print("    --no-inline     - disables inlining of small functions\n");
+    std::print("    --perf-counters - with run, prints hardware performance counters for each function\n");
+    std::print("    --stats         - with lex, parse, com or run, prints timing and memory statistics as JSON to stderr\n");
+    std::print("    --runs <n>      - with bench, the number of timed runs (default 10)\n");
+    std::print("    --warmup <n>    - with bench, the number of untimed runs first (default 2)\n");
+    std::print("    --baseline <f>  - with bench, compares against saved results and fails on a regression\n");
+    std::print("    --save <f>      - with bench, saves the results for use as a baseline\n");
+    std::print("    --socket <f>    - with client, the socket of the server to use\n\n");
+    std::print("Anything after -- is passed to the program, which can read it with @args\n");
 }
 
-auto main(const int argc, const char* argv[]) -> int
+// Parses a non-negative number given as the value of a flag
+auto parse_count(std::string_view text) -> std::optional<std::size_t>
+{
+    auto value = std::size_t{0};
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) return std::nullopt;
+    return value;
+}
+
+// Resolves the path of the program to run, printing why if it cannot be found
+auto source_path(const char* arg) -> std::optional<std::filesystem::path>
 {
-    if (argc != 3) {
+    auto ec = std::error_code{};
+    auto path = std::filesystem::canonical(arg, ec);
+    if (ec) {
+        std::print("could not find '{}': {}\n", arg, ec.message());
+        return std::nullopt;
+    }
+    return path;
+}
+
+auto run(const int argc, const char* argv[]) -> int
+{
+    if (argc < 3) {
         print_usage();
         return 1;
     }
 
+    auto options = anzu::compile_options{};
+    auto perf_counters = false;
+    auto show_stats = false;
+    auto bench = anzu::bench_options{};
+    auto socket = std::optional<std::filesystem::path>{};
+    auto program_args = std::vector<std::string>{};
+    for (int i = 3; i < argc; ++i) {
+        const auto flag = std::string_view{argv[i]};
+        if (flag == "--") {
+            program_args.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        if (flag == "--no-inline") {
+            options.inline_functions = false;
+            continue;
+        }
+        if (flag == "--perf-counters") {
+            perf_counters = true;
+            continue;
+        }
+        if (flag == "--stats") {
+            show_stats = true;
+            continue;
+        }
+
+        const auto takes_value = flag == "--runs" || flag == "--warmup" || flag == "--baseline"
+                              || flag == "--save" || flag == "--socket";
+        if (!takes_value) {
+            std::print("unknown flag: '{}'\n", flag);
+            print_usage();
+            return 1;
+        }
+        if (i + 1 >= argc) {
+            std::print("flag '{}' requires a value\n", flag);
+            print_usage();
+            return 1;
+        }
+        const auto value = std::string_view{argv[++i]};
+
+        if (flag == "--runs" || flag == "--warmup") {
+            const auto count = parse_count(value);
+            if (!count) {
+                std::print("flag '{}' requires a number, got '{}'\n", flag, value);
+                print_usage();
+                return 1;
+            }
+            if (flag == "--runs") {
+                bench.runs = std::max(*count, std::size_t{1});
+            } else {
+                bench.warmup = *count;
+            }
+        } else if (flag == "--baseline") {
+            bench.baseline = value;
+        } else if (flag == "--save") {
+            bench.save_baseline = value;
+        } else {
+            socket = value;
+        }
+    }
+
+    // Runtime statistics are only gathered by a plain run, so rather than leave them out of
+    // the other ways of running a program, those are rejected
+    const auto mode = std::string{argv[2]};
+    if (show_stats && (perf_counters || (mode != "lex" && mode != "parse" && mode != "com" && mode != "run"))) {
+        std::print("--stats only works with lex, parse, com and run, without --perf-counters\n");
+        return 1;
+    }
+
+    // These print nothing of their own so that only the output of the programs is seen
+    if (mode == "serve") {
+        return anzu::serve(argv[1], options);
+    }
+    if (mode == "client") {
+        if (!socket) {
+            std::print("client requires --socket\n");
+            return 1;
+        }
+        const auto file = source_path(argv[1]);
+        if (!file) return 1;
+        return anzu::run_client(*socket, *file, program_args);
+    }
+
+    const auto source = source_path(argv[1]);
+    if (!source) return 1;
+    const auto& file = *source;
+    options.verbose = true;
     const auto timer = anzu::scope_timer{};
-    const auto file = std::filesystem::canonical(argv[1]);
     const auto root = file.parent_path();
-    const auto mode = std::string{argv[2]};
+
+    auto stats = anzu::pipeline_stats{};
+    const auto print_stats = anzu::scope_exit{[&] {
+        if (show_stats) anzu::print_stats_json(stats);
+    }};
 
     if (mode == "lex") {
         std::print("Lexing file '{}'\n", file.string());
@@ -47,14 +181,54 @@ auto main(const int argc, const char* argv[]) -> int
     }
 
     std::print("-> Parsing\n");
+    auto parse_timer = anzu::stopwatch{};
     auto ast = anzu::parse(file);
     if (mode == "parse") {
         print_node(*ast.root);
         return 0;
     }
 
+    auto imports = anzu::parse_imports(ast);
+    stats.parse_seconds = parse_timer.seconds();
+
+    if (show_stats) {
+        // The parser lexes on demand, so lexing is timed separately on its own
+        stats.modules.push_back({file.string(), ast.parse_seconds});
+        for (const auto& [path, mod] : imports) {
+            stats.modules.push_back({path.string(), mod.parse_seconds});
+        }
+        const auto lex_timer = anzu::stopwatch{};
+        const auto lex = [](std::string_view source) {
+            auto ctx = anzu::lexer{source};
+            while (ctx.get_token().type != anzu::token_type::eof);
+        };
+        lex(*ast.source_code);
+        for (const auto& [path, mod] : imports) {
+            lex(*mod.source_code);
+        }
+        stats.lex_seconds = lex_timer.seconds();
+    }
+
     std::print("-> Compiling\n");
-    const auto program = anzu::compile(ast);
+    const auto compile_timer = anzu::stopwatch{};
+    auto compiler_stats = anzu::compile_stats{};
+    const auto program = anzu::compile(ast, std::move(imports), options, &compiler_stats);
+    stats.compile_seconds = compile_timer.seconds();
+    stats.function_instantiations = compiler_stats.function_instantiations;
+    stats.struct_instantiations = compiler_stats.struct_instantiations;
+    stats.rom_bytes = program.rom.size();
+    for (const auto& function : program.functions) {
+        stats.bytecode_bytes += function.code.size();
+    }
+    for (auto& mod : stats.modules) {
+        if (mod.name == file.string()) {
+            mod.compile_seconds = *stats.compile_seconds;
+        }
+        for (const auto& [path, seconds] : compiler_stats.module_seconds) {
+            if (mod.name == path.string()) mod.compile_seconds = seconds;
+        }
+    }
+
     if (mode == "com") {
         print_program(program);
         return 0;
@@ -62,15 +236,44 @@ auto main(const int argc, const char* argv[]) -> int
 
     std::print("-> Running\n\n");
     if (mode == "run") {
-        anzu::run_program(program);
+        const auto run_timer = anzu::stopwatch{};
+        if (perf_counters) {
+            anzu::run_program_perf_counters(program, program_args);
+        } else if (show_stats) {
+            stats.runtime = anzu::run_program_stats(program, program_args);
+        } else {
+            anzu::run_program(program, program_args);
+        }
+        stats.run_seconds = run_timer.seconds();
         return 0;
     }
+    else if (mode == "bench") {
+        return anzu::bench_program(program, bench, program_args) ? 0 : 1;
+    }
     else if (mode == "debug") {
-        anzu::run_program_debug(program);
+        anzu::run_program_debug(program, program_args);
+        return 0;
+    }
+    else if (mode == "profile") {
+        anzu::run_program_profile(program, file.stem().string() + ".folded", program_args);
+        return 0;
+    }
+    else if (mode == "sample") {
+        anzu::run_program_sample(program, program_args);
         return 0;
     }
 
     std::print("unknown mode: '{}'\n", mode);
     print_usage();
     return 1;
-}
\ No newline at end of file
+}
+
+auto main(const int argc, const char* argv[]) -> int
+{
+    try {
+        return run(argc, argv);
+    } catch (const anzu::error& e) {
+        std::print("{}\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,232 @@
+#include "bench.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "compiler.hpp"
+#include "runtime.hpp"
+#include "utility/common.hpp"
+#include "utility/silence_stdout.hpp"
+
+#include <cstdio>
+#include <format>
+#include <functional>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr auto warmup_iterations = std::size_t{1};
+
+// A single benchmark. The body returns the number of seconds spent in the part being
+// measured so that any setup, such as parsing the input for a compile benchmark, is excluded.
+struct benchmark
+{
+    std::string             name;
+    std::size_t             iterations;
+    std::size_t             bytes; // size of the input for throughput, or 0 if not applicable
+    std::function<double()> body;
+};
+
+// A program with many small functions and structs, for measuring the front end on code
+// that is larger than the standard library
+auto generated_source(std::size_t count) -> std::string
+{
+    auto source = std::string{};
+    for (std::size_t i = 0; i != count; ++i) {
+        source += std::format(R"(
+struct point_{0}
+{{
+    x: i64;
+    y: i64;
+}}
+
+fn step_{0}(p: point_{0}, n: i64) -> i64
+{{
+    var total := p.x * n + p.y + {0};
+    var j := 0;
+    while j < n {{
+        if total % 2 == 0 {{
+            total = total / 2;
+        }} else {{
+            total = total * 3 + 1;
+        }}
+        j = j + 1;
+    }}
+    return total;
+}}
+)", i);
+    }
+    source += "\nvar sum := 0;\n";
+    for (std::size_t i = 0; i != count; ++i) {
+        source += std::format("sum = sum + step_{0}(point_{0}(1, 2), 3);\n", i);
+    }
+    return source;
+}
+
+auto compile_source(std::string_view source) -> anzu::bytecode_program
+{
+    auto ast = anzu::parse_source(std::string{source});
+    auto imports = anzu::parse_imports(ast);
+    return anzu::compile(ast, std::move(imports));
+}
+
+constexpr auto loop_program = R"(
+var total := 0;
+var i := 0;
+while i < 1000000 {
+    total = total + i % 7;
+    i = i + 1;
+}
+)";
+
+constexpr auto fibb_program = R"(
+fn fibb(n: i64) -> i64
+{
+    if n < 2 {
+        return n;
+    }
+    return fibb(n - 1) + fibb(n - 2);
+}
+let result := fibb(24);
+)";
+
+constexpr auto sort_program = R"(
+let std := @import("lib/std.az");
+arena a;
+var v := std.vector!(i64).create(a&);
+var seed := 12345;
+for i in std.range(20000) {
+    seed = (seed * 1103515245 + 12345) % 2147483648;
+    v.push(seed);
+}
+std.sort(v.to_span());
+)";
+
+constexpr auto split_program = R"(
+let std := @import("lib/std.az");
+let text := "alpha,beta,gamma,delta,epsilon,zeta,eta,theta,iota,kappa,lambda,mu,nu,xi,omicron,pi,rho,sigma,tau,upsilon";
+var count := 0u;
+for i in std.range(2000) {
+    for word in std.split(text, ",") {
+        count = count + @len(word);
+    }
+}
+)";
+
+constexpr auto vector_program = R"(
+let std := @import("lib/std.az");
+arena a;
+var v := std.vector!(i64).create(a&);
+for i in std.range(200000) {
+    v.push(i);
+}
+)";
+
+auto lex_benchmark(std::string name, std::string source) -> benchmark
+{
+    const auto bytes = source.size();
+    return {std::move(name), 50, bytes, [source = std::move(source)] {
+        const auto timer = anzu::stopwatch{};
+        auto ctx = anzu::lexer{source};
+        while (ctx.get_token().type != anzu::token_type::eof);
+        return timer.seconds();
+    }};
+}
+
+auto parse_benchmark(std::string name, std::string source) -> benchmark
+{
+    const auto bytes = source.size();
+    return {std::move(name), 50, bytes, [source = std::move(source)] {
+        const auto timer = anzu::stopwatch{};
+        const auto ast = anzu::parse_source(source);
+        return timer.seconds();
+    }};
+}
+
+// The bytes given are the size of the code being compiled, including any imports
+auto compile_benchmark(std::string name, std::string source, std::size_t bytes) -> benchmark
+{
+    return {std::move(name), 20, bytes, [source = std::move(source)] {
+        auto ast = anzu::parse_source(source);
+        auto imports = anzu::parse_imports(ast);
+        const auto timer = anzu::stopwatch{};
+        const auto program = anzu::compile(ast, std::move(imports));
+        return timer.seconds();
+    }};
+}
+
+auto vm_benchmark(std::string name, std::string_view source) -> benchmark
+{
+    auto program = std::make_shared<anzu::bytecode_program>(compile_source(source));
+    return {std::move(name), 10, 0, [program] {
+        const auto timer = anzu::stopwatch{};
+        anzu::run_program(*program);
+        return timer.seconds();
+    }};
+}
+
+auto all_benchmarks() -> std::vector<benchmark>
+{
+    const auto std_source = *anzu::read_file("lib/std.az");
+    const auto gen_source = generated_source(200);
+
+    auto benchmarks = std::vector<benchmark>{};
+    benchmarks.push_back(lex_benchmark("lex/std", std_source));
+    benchmarks.push_back(lex_benchmark("lex/generated", gen_source));
+    benchmarks.push_back(parse_benchmark("parse/std", std_source));
+    benchmarks.push_back(parse_benchmark("parse/generated", gen_source));
+    benchmarks.push_back(compile_benchmark("compile/std", R"(let std := @import("lib/std.az");)", std_source.size()));
+    benchmarks.push_back(compile_benchmark("compile/generated", gen_source, gen_source.size()));
+    benchmarks.push_back(vm_benchmark("vm/loop", loop_program));
+    benchmarks.push_back(vm_benchmark("vm/fibb", fibb_program));
+    benchmarks.push_back(vm_benchmark("vm/sort", sort_program));
+    benchmarks.push_back(vm_benchmark("vm/split", split_program));
+    benchmarks.push_back(vm_benchmark("vm/vector", vector_program));
+    return benchmarks;
+}
+
+}
+
+// Runs the benchmarks whose names contain the given filter (or all of them) and prints
+// the results as JSON to stdout. Progress is printed to stderr.
+auto main(const int argc, const char* argv[]) -> int
+{
+    const auto filter = std::string_view{argc > 1 ? argv[1] : ""};
+
+    auto results = std::vector<std::string>{};
+    for (const auto& bench : all_benchmarks()) {
+        if (!bench.name.contains(filter)) continue;
+        std::fprintf(stderr, "running %s\n", bench.name.c_str());
+
+        auto samples = std::vector<double>{};
+        {
+            const auto silence = anzu::silence_stdout{};
+            for (std::size_t i = 0; i != warmup_iterations; ++i) {
+                bench.body();
+            }
+            for (std::size_t i = 0; i != bench.iterations; ++i) {
+                samples.push_back(bench.body() * 1000.0);
+            }
+        }
+
+        const auto s = anzu::summarise(samples);
+        auto result = std::format(
+            R"({{"name": "{}", "iterations": {}, "median_ms": {}, "mean_ms": {}, "variance_ms2": {}, "min_ms": {}, "max_ms": {})",
+            bench.name, bench.iterations, s.median, s.mean, s.variance, s.min, s.max
+        );
+        if (bench.bytes > 0) {
+            result += std::format(R"(, "median_mb_per_s": {})", (bench.bytes / 1e6) / (s.median / 1000.0));
+        }
+        result += "}";
+        results.push_back(std::move(result));
+    }
+
+    std::print("{{\n  \"benchmarks\": [\n");
+    for (std::size_t i = 0; i != results.size(); ++i) {
+        std::print("    {}{}\n", results[i], i + 1 == results.size() ? "" : ",");
+    }
+    std::print("  ]\n}}\n");
+    return 0;
+}
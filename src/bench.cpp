@@ -0,0 +1,123 @@
+#include "bench.hpp"
+#include "runtime.hpp"
+#include "utility/common.hpp"
+#include "utility/silence_stdout.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace anzu {
+namespace {
+
+// Linear interpolation between the closest ranks of a sorted sample
+auto percentile(const std::vector<double>& sorted, double p) -> double
+{
+    const auto rank = p * static_cast<double>(sorted.size() - 1);
+    const auto lower = static_cast<std::size_t>(std::floor(rank));
+    const auto upper = std::min(lower + 1, sorted.size() - 1);
+    const auto fraction = rank - static_cast<double>(lower);
+    return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+}
+
+auto to_json(const timing_summary& summary, std::size_t runs) -> std::string
+{
+    return std::format(
+        "{{\"runs\": {}, \"min_ms\": {}, \"median_ms\": {}, \"p95_ms\": {}, \"mean_ms\": {}, \"variance_ms2\": {}, \"max_ms\": {}}}\n",
+        runs, summary.min, summary.median, summary.p95, summary.mean, summary.variance, summary.max
+    );
+}
+
+// Reads a number from a baseline file written by this bench mode. This is not a general
+// JSON parser, it only needs to understand the files that to_json produces.
+auto read_json_number(std::string_view json, std::string_view key) -> std::optional<double>
+{
+    const auto quoted = std::format("\"{}\":", key);
+    auto pos = json.find(quoted);
+    if (pos == std::string_view::npos) return std::nullopt;
+    pos = json.find_first_not_of(" \t\r\n", pos + quoted.size());
+    if (pos == std::string_view::npos) return std::nullopt;
+    auto value = 0.0;
+    const auto [ptr, ec] = std::from_chars(json.data() + pos, json.data() + json.size(), value);
+    if (ec != std::errc{}) return std::nullopt;
+    return value;
+}
+
+}
+
+auto summarise(std::vector<double> samples) -> timing_summary
+{
+    std::ranges::sort(samples);
+    const auto count = static_cast<double>(samples.size());
+    auto mean = 0.0;
+    for (const auto sample : samples) mean += sample;
+    mean /= count;
+    auto variance = 0.0;
+    for (const auto sample : samples) variance += (sample - mean) * (sample - mean);
+    variance /= count;
+    return {
+        .min = samples.front(),
+        .median = percentile(samples, 0.5),
+        .p95 = percentile(samples, 0.95),
+        .mean = mean,
+        .variance = variance,
+        .max = samples.back()
+    };
+}
+
+auto bench_program(const bytecode_program& prog, const bench_options& options, std::span<const std::string> args) -> bool
+{
+    auto samples = std::vector<double>{};
+    samples.reserve(options.runs);
+    {
+        const auto silence = silence_stdout{};
+        for (std::size_t i = 0; i != options.warmup; ++i) {
+            run_program(prog, args);
+        }
+        for (std::size_t i = 0; i != options.runs; ++i) {
+            const auto timer = stopwatch{};
+            run_program(prog, args);
+            samples.push_back(timer.seconds() * 1000.0);
+        }
+    }
+
+    const auto summary = summarise(samples);
+    std::print("runs={} warmup={}\n", options.runs, options.warmup);
+    std::print("  min    {:>10.3f} ms\n", summary.min);
+    std::print("  median {:>10.3f} ms\n", summary.median);
+    std::print("  p95    {:>10.3f} ms\n", summary.p95);
+
+    if (options.save_baseline) {
+        auto file = std::ofstream{*options.save_baseline};
+        if (file) {
+            file << to_json(summary, options.runs);
+            std::print("saved baseline to '{}'\n", options.save_baseline->string());
+        } else {
+            std::print("failed to write baseline to '{}'\n", options.save_baseline->string());
+        }
+    }
+
+    if (!options.baseline) return true;
+    auto file = std::ifstream{*options.baseline};
+    auto contents = std::stringstream{};
+    contents << file.rdbuf();
+    const auto baseline = read_json_number(contents.str(), "median_ms");
+    if (!file || !baseline) {
+        std::print("failed to read baseline from '{}'\n", options.baseline->string());
+        return false;
+    }
+
+    const auto change = (summary.median - *baseline) / *baseline;
+    const auto regressed = change > options.threshold;
+    std::print("baseline median {:.3f} ms, change {:+.2f}%{}\n",
+               *baseline, change * 100.0, regressed ? " REGRESSION" : "");
+    return !regressed;
+}
+
+}
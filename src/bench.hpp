@@ -0,0 +1,43 @@
+#pragma once
+#include "bytecode.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace anzu {
+
+struct timing_summary
+{
+    double min;
+    double median;
+    double p95;
+    double mean;
+    double variance;
+    double max;
+};
+
+// Summarises a set of timings. There must be at least one sample.
+auto summarise(std::vector<double> samples) -> timing_summary;
+
+struct bench_options
+{
+    std::size_t runs   = 10;
+    std::size_t warmup = 2;
+
+    // A run is a regression if its median is this much slower than the baseline median
+    double threshold = 0.05;
+
+    std::optional<std::filesystem::path> baseline;      // compare against these results
+    std::optional<std::filesystem::path> save_baseline; // write the results here
+};
+
+// Runs the program repeatedly, each time in a fresh context with its output suppressed,
+// and prints statistics for the run times. Returns false if the results are a regression
+// compared to the baseline. The args are passed to each run of the program.
+auto bench_program(const bytecode_program& prog, const bench_options& options, std::span<const std::string> args = {}) -> bool;
+
+}
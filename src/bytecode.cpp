@@ -1,5 +1,6 @@
 #include "bytecode.hpp"
 
+#include <algorithm>
 #include <print>
 #include <cstddef>
 #include <cstring>
@@ -162,6 +163,11 @@ auto print_op(std::string_view rom, const std::byte* start, const std::byte* ptr
             const auto type_size = read_at<std::uint64_t>(&ptr);
             std::print("RETURN: type_size={}\n", type_size);
         } break;
+        case op::inline_ret: {
+            const auto offset = read_at<std::uint64_t>(&ptr);
+            const auto type_size = read_at<std::uint64_t>(&ptr);
+            std::print("INLINE_RETURN: base_ptr + {}, type_size={}\n", offset, type_size);
+        } break;
         case op::call_static: {
             const auto id = read_at<std::uint64_t>(&ptr);
             const auto args_size = read_at<std::uint64_t>(&ptr);
@@ -169,7 +175,18 @@ auto print_op(std::string_view rom, const std::byte* start, const std::byte* ptr
         } break;
         case op::call_ptr: {
             const auto args_size = read_at<std::uint64_t>(&ptr);
-            std::print("CALL_PTR: args_size={}\n", args_size);
+            const auto return_size = read_at<std::uint64_t>(&ptr);
+            std::print("CALL_PTR: args_size={} return_size={}\n", args_size, return_size);
+        } break;
+        case op::push_temp: {
+            const auto size = read_at<std::uint64_t>(&ptr);
+            const auto distance = read_at<std::uint64_t>(&ptr);
+            std::print("PUSH_TEMP: size={} distance={}\n", size, distance);
+        } break;
+        case op::pop_temps: {
+            const auto temps_size = read_at<std::uint64_t>(&ptr);
+            const auto value_size = read_at<std::uint64_t>(&ptr);
+            std::print("POP_TEMPS: temps_size={} value_size={}\n", temps_size, value_size);
         } break;
         case op::assert: {
             const auto index = read_at<std::uint64_t>(&ptr);
@@ -178,9 +195,84 @@ auto print_op(std::string_view rom, const std::byte* start, const std::byte* ptr
             std::print("ASSERT: msg={}\n", std::string_view{data, size});
         } break;
 
+        case op::program_args: { std::print("PROGRAM_ARGS\n"); } break;
         case op::read_file: {
             std::print("READ_FILE\n");
         } break;
+        case op::map_file: {
+            std::print("MAP_FILE\n");
+        } break;
+        case op::open_reader: { std::print("OPEN_READER\n"); } break;
+        case op::reader_valid: { std::print("READER_VALID\n"); } break;
+        case op::read_line: { std::print("READ_LINE\n"); } break;
+        case op::open_write: { std::print("OPEN_WRITE\n"); } break;
+        case op::write: { std::print("WRITE\n"); } break;
+        case op::write_i64: { std::print("WRITE_I64\n"); } break;
+        case op::write_f64: { std::print("WRITE_F64\n"); } break;
+        case op::close: { std::print("CLOSE\n"); } break;
+        case op::find: { std::print("FIND\n"); } break;
+        case op::find_char: { std::print("FIND_CHAR\n"); } break;
+        case op::parse_i64: { std::print("PARSE_I64\n"); } break;
+        case op::parse_u64: { std::print("PARSE_U64\n"); } break;
+        case op::parse_f64: { std::print("PARSE_F64\n"); } break;
+        case op::sort: {
+            const auto key = read_at<std::uint64_t>(&ptr);
+            std::print("SORT: key={}\n", key);
+        } break;
+        case op::sort_by: {
+            const auto key = read_at<std::uint64_t>(&ptr);
+            const auto type_size = read_at<std::uint64_t>(&ptr);
+            std::print("SORT_BY: key={} type_size={}\n", key, type_size);
+        } break;
+        case op::hash_bytes: {
+            const auto type_size = read_at<std::uint64_t>(&ptr);
+            std::print("HASH_BYTES: type_size={}\n", type_size);
+        } break;
+        case op::span_sum: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_SUM: type={}\n", type);
+        } break;
+        case op::span_min: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_MIN: type={}\n", type);
+        } break;
+        case op::span_max: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_MAX: type={}\n", type);
+        } break;
+        case op::span_count_eq: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_COUNT_EQ: type={}\n", type);
+        } break;
+        case op::span_dot: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_DOT: type={}\n", type);
+        } break;
+        case op::span_add: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_ADD: type={}\n", type);
+        } break;
+        case op::span_mul: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_MUL: type={}\n", type);
+        } break;
+        case op::span_scale: {
+            const auto type = read_at<std::uint64_t>(&ptr);
+            std::print("SPAN_SCALE: type={}\n", type);
+        } break;
+
+        case op::spawn: {
+            const auto args_size = read_at<std::uint64_t>(&ptr);
+            std::print("SPAWN: args_size={}\n", args_size);
+        } break;
+        case op::join: { std::print("JOIN\n"); } break;
+        case op::atomic_load: { std::print("ATOMIC_LOAD\n"); } break;
+        case op::atomic_store: { std::print("ATOMIC_STORE\n"); } break;
+        case op::atomic_fetch_add: { std::print("ATOMIC_FETCH_ADD\n"); } break;
+        case op::parallel_for: {
+            const auto type_size = read_at<std::uint64_t>(&ptr);
+            std::print("PARALLEL_FOR: type_size={}\n", type_size);
+        } break;
         
         case op::null_to_i64: { std::print("NULL_TO_I64\n"); } break;
         case op::bool_to_i64: { std::print("BOOL_TO_I64\n"); } break;
@@ -247,15 +339,24 @@ auto print_op(std::string_view rom, const std::byte* start, const std::byte* ptr
         case op::i32_neg: { std::print("I32_NEG\n"); } break;
         case op::i64_neg: { std::print("I64_NEG\n"); } break;
         case op::f64_neg: { std::print("F64_NEG\n"); } break;
-        case op::print_null: { std::print("PRINT_NULL\n"); } break;
-        case op::print_bool: { std::print("PRINT_BOOL\n"); } break;
-        case op::print_char: { std::print("PRINT_CHAR\n"); } break;
-        case op::print_i32: { std::print("PRINT_I32\n"); } break;
-        case op::print_i64: { std::print("PRINT_I64\n"); } break;
-        case op::print_u64: { std::print("PRINT_U64\n"); } break;
-        case op::print_f64: { std::print("PRINT_F64\n"); } break;
-        case op::print_char_span: { std::print("PRINT_STRING_LITERAL\n"); break;
-        case op::print_ptr: { std::print("PRINT_PTR\n"); } break;
+        case op::f64_sqrt: { std::print("F64_SQRT\n"); } break;
+        case op::f64_floor: { std::print("F64_FLOOR\n"); } break;
+        case op::f64_ceil: { std::print("F64_CEIL\n"); } break;
+        case op::f64_round: { std::print("F64_ROUND\n"); } break;
+        case op::f64_abs: { std::print("F64_ABS\n"); } break;
+        case op::f64_exp: { std::print("F64_EXP\n"); } break;
+        case op::f64_log: { std::print("F64_LOG\n"); } break;
+        case op::f64_sin: { std::print("F64_SIN\n"); } break;
+        case op::f64_cos: { std::print("F64_COS\n"); } break;
+        case op::f64_pow: { std::print("F64_POW\n"); } break;
+        case op::f64_min: { std::print("F64_MIN\n"); } break;
+        case op::f64_max: { std::print("F64_MAX\n"); } break;
+        case op::f64_fma: { std::print("F64_FMA\n"); } break;
+        case op::print_fmt: {
+            const auto index = read_at<std::uint64_t>(&ptr);
+            const auto size = read_at<std::uint64_t>(&ptr);
+            const auto args_size = read_at<std::uint64_t>(&ptr);
+            std::print("PRINT_FMT: format_index={} format_size={} args_size={}\n", index, size, args_size);
         } break;
         default: {
             std::print("UNKNOWN\n");
@@ -265,6 +366,256 @@ auto print_op(std::string_view rom, const std::byte* start, const std::byte* ptr
     return ptr;
 }
 
+auto add_line(std::vector<line_entry>& lines, const line_entry& entry) -> void
+{
+    // Any code for the previous entry was discarded, so it can be replaced
+    if (!lines.empty() && lines.back().offset == entry.offset) {
+        lines.pop_back();
+    }
+    if (!lines.empty() && lines.back().module == entry.module && lines.back().line == entry.line) {
+        return;
+    }
+    lines.push_back(entry);
+}
+
+auto find_line(const std::vector<line_entry>& lines, std::size_t offset) -> const line_entry*
+{
+    const auto it = std::ranges::upper_bound(lines, offset, {}, &line_entry::offset);
+    return it == lines.begin() ? nullptr : &*std::prev(it);
+}
+
+auto numeric_size(numeric_type type) -> std::size_t
+{
+    switch (type) {
+        case numeric_type::i32_type: return sizeof(std::int32_t);
+        case numeric_type::i64_type: return sizeof(std::int64_t);
+        case numeric_type::u64_type: return sizeof(std::uint64_t);
+        case numeric_type::f64_type: return sizeof(double);
+    }
+    return 0;
+}
+
+auto op_operands_size(op op_code) -> std::size_t
+{
+    switch (op_code) {
+        case op::push_i32: return sizeof(std::int32_t);
+        case op::push_i64: return sizeof(std::int64_t);
+        case op::push_u64: return sizeof(std::uint64_t);
+        case op::push_f64: return sizeof(double);
+        case op::push_char: return sizeof(char);
+        case op::push_bool: return sizeof(bool);
+
+        case op::push_ptr_global:
+        case op::push_ptr_local:
+        case op::push_function_ptr:
+        case op::nth_element_ptr:
+        case op::nth_element_val:
+        case op::push_subspan:
+        case op::arena_alloc:
+        case op::arena_alloc_array:
+        case op::arena_realloc_array:
+        case op::load:
+        case op::save:
+        case op::push:
+        case op::pop:
+        case op::memcpy:
+        case op::memcmp:
+        case op::jump:
+        case op::jump_if_true:
+        case op::jump_if_false:
+        case op::spawn:
+        case op::parallel_for:
+        case op::sort:
+        case op::hash_bytes:
+        case op::span_sum:
+        case op::span_min:
+        case op::span_max:
+        case op::span_count_eq:
+        case op::span_dot:
+        case op::span_add:
+        case op::span_mul:
+        case op::span_scale:
+        case op::ret:
+            return sizeof(std::uint64_t);
+
+        case op::push_string_literal:
+        case op::push_val_global:
+        case op::push_val_local:
+        case op::call_static:
+        case op::call_ptr:
+        case op::inline_ret:
+        case op::push_temp:
+        case op::pop_temps:
+        case op::assert:
+        case op::sort_by:
+            return 2 * sizeof(std::uint64_t);
+
+        case op::print_fmt:
+            return 3 * sizeof(std::uint64_t);
+
+        default:
+            return 0;
+    }
+}
+
+auto op_name(op op_code) -> std::string_view
+{
+    switch (op_code) {
+        case op::end_program: return "end_program";
+        case op::push_i32: return "push_i32";
+        case op::push_i64: return "push_i64";
+        case op::push_u64: return "push_u64";
+        case op::push_f64: return "push_f64";
+        case op::push_char: return "push_char";
+        case op::push_bool: return "push_bool";
+        case op::push_null: return "push_null";
+        case op::push_nullptr: return "push_nullptr";
+        case op::push_string_literal: return "push_string_literal";
+        case op::push_ptr_global: return "push_ptr_global";
+        case op::push_ptr_local: return "push_ptr_local";
+        case op::push_val_global: return "push_val_global";
+        case op::push_val_local: return "push_val_local";
+        case op::push_function_ptr: return "push_function_ptr";
+        case op::nth_element_ptr: return "nth_element_ptr";
+        case op::nth_element_val: return "nth_element_val";
+        case op::span_ptr_to_len: return "span_ptr_to_len";
+        case op::push_subspan: return "push_subspan";
+        case op::arena_new: return "arena_new";
+        case op::arena_delete: return "arena_delete";
+        case op::arena_alloc: return "arena_alloc";
+        case op::arena_alloc_array: return "arena_alloc_array";
+        case op::arena_realloc_array: return "arena_realloc_array";
+        case op::arena_size: return "arena_size";
+        case op::load: return "load";
+        case op::save: return "save";
+        case op::push: return "push";
+        case op::pop: return "pop";
+        case op::memcpy: return "memcpy";
+        case op::memcmp: return "memcmp";
+        case op::jump: return "jump";
+        case op::jump_if_true: return "jump_if_true";
+        case op::jump_if_false: return "jump_if_false";
+        case op::call_static: return "call_static";
+        case op::call_ptr: return "call_ptr";
+        case op::push_temp: return "push_temp";
+        case op::pop_temps: return "pop_temps";
+        case op::ret: return "ret";
+        case op::inline_ret: return "inline_ret";
+        case op::assert: return "assert";
+        case op::program_args: return "program_args";
+        case op::read_file: return "read_file";
+        case op::map_file: return "map_file";
+        case op::open_reader: return "open_reader";
+        case op::reader_valid: return "reader_valid";
+        case op::read_line: return "read_line";
+        case op::open_write: return "open_write";
+        case op::write: return "write";
+        case op::write_i64: return "write_i64";
+        case op::write_f64: return "write_f64";
+        case op::close: return "close";
+        case op::find: return "find";
+        case op::find_char: return "find_char";
+        case op::parse_i64: return "parse_i64";
+        case op::parse_u64: return "parse_u64";
+        case op::parse_f64: return "parse_f64";
+        case op::sort: return "sort";
+        case op::sort_by: return "sort_by";
+        case op::hash_bytes: return "hash_bytes";
+        case op::span_sum: return "span_sum";
+        case op::span_min: return "span_min";
+        case op::span_max: return "span_max";
+        case op::span_count_eq: return "span_count_eq";
+        case op::span_dot: return "span_dot";
+        case op::span_add: return "span_add";
+        case op::span_mul: return "span_mul";
+        case op::span_scale: return "span_scale";
+        case op::spawn: return "spawn";
+        case op::join: return "join";
+        case op::atomic_load: return "atomic_load";
+        case op::atomic_store: return "atomic_store";
+        case op::atomic_fetch_add: return "atomic_fetch_add";
+        case op::parallel_for: return "parallel_for";
+        case op::null_to_i64: return "null_to_i64";
+        case op::bool_to_i64: return "bool_to_i64";
+        case op::char_to_i64: return "char_to_i64";
+        case op::i32_to_i64: return "i32_to_i64";
+        case op::u64_to_i64: return "u64_to_i64";
+        case op::f64_to_i64: return "f64_to_i64";
+        case op::null_to_u64: return "null_to_u64";
+        case op::bool_to_u64: return "bool_to_u64";
+        case op::char_to_u64: return "char_to_u64";
+        case op::i32_to_u64: return "i32_to_u64";
+        case op::i64_to_u64: return "i64_to_u64";
+        case op::f64_to_u64: return "f64_to_u64";
+        case op::char_eq: return "char_eq";
+        case op::char_ne: return "char_ne";
+        case op::i32_add: return "i32_add";
+        case op::i32_sub: return "i32_sub";
+        case op::i32_mul: return "i32_mul";
+        case op::i32_div: return "i32_div";
+        case op::i32_mod: return "i32_mod";
+        case op::i32_eq: return "i32_eq";
+        case op::i32_ne: return "i32_ne";
+        case op::i32_lt: return "i32_lt";
+        case op::i32_le: return "i32_le";
+        case op::i32_gt: return "i32_gt";
+        case op::i32_ge: return "i32_ge";
+        case op::i64_add: return "i64_add";
+        case op::i64_sub: return "i64_sub";
+        case op::i64_mul: return "i64_mul";
+        case op::i64_div: return "i64_div";
+        case op::i64_mod: return "i64_mod";
+        case op::i64_eq: return "i64_eq";
+        case op::i64_ne: return "i64_ne";
+        case op::i64_lt: return "i64_lt";
+        case op::i64_le: return "i64_le";
+        case op::i64_gt: return "i64_gt";
+        case op::i64_ge: return "i64_ge";
+        case op::u64_add: return "u64_add";
+        case op::u64_sub: return "u64_sub";
+        case op::u64_mul: return "u64_mul";
+        case op::u64_div: return "u64_div";
+        case op::u64_mod: return "u64_mod";
+        case op::u64_eq: return "u64_eq";
+        case op::u64_ne: return "u64_ne";
+        case op::u64_lt: return "u64_lt";
+        case op::u64_le: return "u64_le";
+        case op::u64_gt: return "u64_gt";
+        case op::u64_ge: return "u64_ge";
+        case op::f64_add: return "f64_add";
+        case op::f64_sub: return "f64_sub";
+        case op::f64_mul: return "f64_mul";
+        case op::f64_div: return "f64_div";
+        case op::f64_eq: return "f64_eq";
+        case op::f64_ne: return "f64_ne";
+        case op::f64_lt: return "f64_lt";
+        case op::f64_le: return "f64_le";
+        case op::f64_gt: return "f64_gt";
+        case op::f64_ge: return "f64_ge";
+        case op::bool_eq: return "bool_eq";
+        case op::bool_ne: return "bool_ne";
+        case op::bool_not: return "bool_not";
+        case op::i32_neg: return "i32_neg";
+        case op::i64_neg: return "i64_neg";
+        case op::f64_neg: return "f64_neg";
+        case op::f64_sqrt: return "f64_sqrt";
+        case op::f64_floor: return "f64_floor";
+        case op::f64_ceil: return "f64_ceil";
+        case op::f64_round: return "f64_round";
+        case op::f64_abs: return "f64_abs";
+        case op::f64_exp: return "f64_exp";
+        case op::f64_log: return "f64_log";
+        case op::f64_sin: return "f64_sin";
+        case op::f64_cos: return "f64_cos";
+        case op::f64_pow: return "f64_pow";
+        case op::f64_min: return "f64_min";
+        case op::f64_max: return "f64_max";
+        case op::f64_fma: return "f64_fma";
+        case op::print_fmt: return "print_fmt";
+        default: return "unknown";
+    }
+}
+
 auto linebreak() { std::print("==================================\n"); }
 
 auto print_program(const bytecode_program& prog) -> void
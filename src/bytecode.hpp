@@ -5,19 +5,36 @@
 
 namespace anzu {
 
+// Marks the bytecode from the given offset up to the next entry as coming from a line
+// of source code
+struct line_entry
+{
+    std::uint32_t offset;
+    std::uint32_t module; // index into bytecode_program::modules
+    std::uint32_t line;
+};
+
 struct bytecode_function
 {
-    std::string            name;
-    std::size_t            id;
-    std::vector<std::byte> code;
+    std::string             name;
+    std::size_t             id;
+    std::vector<std::byte>  code;
+    std::vector<line_entry> lines = {};
 };
 
 struct bytecode_program
 {
     std::vector<bytecode_function> functions;
     std::string                    rom;
+    std::vector<std::string>       modules = {};
 };
 
+// Appends to a line table, merging with the last entry where possible
+auto add_line(std::vector<line_entry>& lines, const line_entry& entry) -> void;
+
+// Returns the entry covering the given offset, or nullptr if there is none
+auto find_line(const std::vector<line_entry>& lines, std::size_t offset) -> const line_entry*;
+
 auto print_program(const bytecode_program& prog) -> void;
 auto print_op(std::string_view rom, const std::byte* start, const std::byte* ptr) -> const std::byte*;
 
@@ -64,10 +81,51 @@ enum class op : std::uint8_t
     jump_if_false,
     call_static,
     call_ptr,
+    push_temp,
+    pop_temps,
     ret,
+    inline_ret,
     assert,
 
+    program_args,
     read_file,
+    map_file,
+    open_reader,
+    reader_valid,
+    read_line,
+    open_write,
+    write,
+    write_i64,
+    write_f64,
+    close,
+
+    find,
+    find_char,
+
+    parse_i64,
+    parse_u64,
+    parse_f64,
+
+    sort,
+    sort_by,
+
+    hash_bytes,
+
+    span_sum,
+    span_min,
+    span_max,
+    span_count_eq,
+    span_dot,
+    span_add,
+    span_mul,
+    span_scale,
+
+    spawn,
+    join,
+    atomic_load,
+    atomic_store,
+    atomic_fetch_add,
+    parallel_for,
 
     null_to_i64,
     bool_to_i64,
@@ -141,15 +199,64 @@ enum class op : std::uint8_t
     i64_neg,
     f64_neg,
 
-    print_null,
-    print_bool,
-    print_char,
-    print_i32,
-    print_i64,
-    print_u64,
-    print_f64,
-    print_char_span,
-    print_ptr,
+    f64_sqrt,
+    f64_floor,
+    f64_ceil,
+    f64_round,
+    f64_abs,
+    f64_exp,
+    f64_log,
+    f64_sin,
+    f64_cos,
+    f64_pow,
+    f64_min,
+    f64_max,
+    f64_fma,
+
+    print_fmt,
 };
 
+// The parts of a print statement, which op::print_fmt reads from a format in the rom. Each
+// part is a single byte, except for literals which are followed by a u64 size and the text.
+enum class print_part : std::uint8_t
+{
+    literal,
+    null_value,
+    bool_value,
+    char_value,
+    i32_value,
+    i64_value,
+    u64_value,
+    f64_value,
+    ptr_value,
+    char_span_value,
+};
+
+// The types that op::sort and op::sort_by can sort by, passed as their first operand
+enum class sort_key : std::uint8_t
+{
+    bool_key,
+    char_key,
+    i32_key,
+    i64_key,
+    u64_key,
+    f64_key,
+};
+
+// The element types of the spans that the span_ ops work on, passed as their operand
+enum class numeric_type : std::uint8_t
+{
+    i32_type,
+    i64_type,
+    u64_type,
+    f64_type,
+};
+
+auto numeric_size(numeric_type type) -> std::size_t;
+
+// Returns the number of bytes of operands that follow the given op code
+auto op_operands_size(op op_code) -> std::size_t;
+
+auto op_name(op op_code) -> std::string_view;
+
 }
\ No newline at end of file
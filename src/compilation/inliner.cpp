@@ -0,0 +1,440 @@
+#include "inliner.hpp"
+#include "compiler.hpp"
+#include "utility/common.hpp"
+#include "utility/memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace anzu {
+namespace {
+
+// Functions with at most this many bytes of bytecode get copied into their call sites
+constexpr auto max_inline_size = std::size_t{320};
+
+constexpr auto unknown_depth = std::numeric_limits<std::size_t>::max();
+
+template <typename T>
+auto read_at(const std::vector<std::byte>& code, std::size_t pos) -> T
+{
+    auto ret = T{};
+    std::memcpy(&ret, &code[pos], sizeof(T));
+    return ret;
+}
+
+auto operand(const std::vector<std::byte>& code, std::size_t pos, std::size_t index) -> std::uint64_t
+{
+    return read_at<std::uint64_t>(code, pos + sizeof(op) + index * sizeof(std::uint64_t));
+}
+
+// The size of the elements of the spans that a span_ op works on
+auto element_size(const std::vector<std::byte>& code, std::size_t pos) -> std::size_t
+{
+    return numeric_size(static_cast<numeric_type>(operand(code, pos, 0)));
+}
+
+auto is_jump(op op_code) -> bool
+{
+    return op_code == op::jump || op_code == op::jump_if_true || op_code == op::jump_if_false;
+}
+
+// Returns the stack depth after executing the given instruction. Every op is listed and there
+// is no default, so a new op that is missing here fails the build rather than getting a
+// wrong depth.
+auto depth_after(const compiler& com, const std::vector<std::byte>& code, std::size_t pos, std::size_t depth)
+    -> std::size_t
+{
+    const auto op_code = static_cast<op>(code[pos]);
+    switch (op_code) {
+        case op::push_i32: return depth + sizeof(std::int32_t);
+        case op::push_i64: return depth + sizeof(std::int64_t);
+        case op::push_u64: return depth + sizeof(std::uint64_t);
+        case op::push_f64: return depth + sizeof(double);
+        case op::push_char: return depth + sizeof(char);
+        case op::push_bool: return depth + sizeof(bool);
+        case op::push_null: return depth + 1;
+        case op::push_nullptr: return depth + sizeof(std::byte*);
+
+        case op::push_string_literal: return depth + 2 * sizeof(std::uint64_t);
+        case op::push_ptr_global: return depth + sizeof(std::byte*);
+        case op::push_ptr_local: return depth + sizeof(std::byte*);
+        case op::push_val_global: return depth + operand(code, pos, 1);
+        case op::push_val_local: return depth + operand(code, pos, 1);
+        case op::push_function_ptr: return depth + sizeof(std::uint64_t);
+
+        case op::nth_element_ptr: return depth - sizeof(std::uint64_t);
+        case op::nth_element_val: return depth - 2 * sizeof(std::uint64_t) + operand(code, pos, 0);
+        case op::push_subspan: return depth - sizeof(std::uint64_t);
+
+        case op::arena_new: return depth + sizeof(std::byte*);
+        case op::arena_delete: return depth - sizeof(std::byte*);
+        case op::arena_alloc: return depth - operand(code, pos, 0);
+        case op::arena_alloc_array: return depth - operand(code, pos, 0);
+        case op::arena_realloc_array: return depth - 2 * sizeof(std::uint64_t) - operand(code, pos, 0);
+
+        case op::load: return depth - sizeof(std::byte*) + operand(code, pos, 0);
+        case op::save: return depth - sizeof(std::byte*) - operand(code, pos, 0);
+        case op::push: return depth + operand(code, pos, 0);
+        case op::pop: return depth - operand(code, pos, 0);
+        case op::memcpy: return depth - 4 * sizeof(std::uint64_t) + 1;
+        case op::memcmp: return depth - 2 * sizeof(std::byte*) + sizeof(bool);
+        case op::call_static: {
+            const auto& callee = com.functions[operand(code, pos, 0)];
+            return depth - operand(code, pos, 1) + com.types.size_of(callee.return_type);
+        }
+        case op::call_ptr: return depth - sizeof(std::uint64_t) - operand(code, pos, 0) + operand(code, pos, 1);
+        case op::push_temp: return depth - operand(code, pos, 0) + sizeof(std::byte*);
+        case op::pop_temps: return depth - operand(code, pos, 0);
+        case op::inline_ret: return operand(code, pos, 0) + operand(code, pos, 1);
+        case op::assert: return depth - sizeof(bool);
+
+        case op::program_args: return depth + 2 * sizeof(std::uint64_t);
+        case op::read_file:
+        case op::map_file: return depth - sizeof(std::byte*);
+        case op::open_reader: return depth - 2 * sizeof(std::uint64_t);
+        case op::reader_valid: return depth - sizeof(std::uint64_t) + sizeof(bool);
+        case op::read_line: return depth + sizeof(std::uint64_t);
+        case op::open_write: return depth - 2 * sizeof(std::uint64_t);
+        case op::write: return depth - 3 * sizeof(std::uint64_t) + 1;
+        case op::write_i64:
+        case op::write_f64: return depth - 2 * sizeof(std::uint64_t) + 1;
+        case op::close: return depth - sizeof(std::uint64_t) + 1;
+
+        case op::find: return depth - 4 * sizeof(std::uint64_t);
+        case op::find_char: return depth - 2 * sizeof(std::uint64_t) - sizeof(char);
+
+        // Each replaces a span with the value and the number of characters used
+        case op::parse_i64:
+        case op::parse_u64:
+        case op::parse_f64: return depth;
+
+        case op::sort: return depth - 2 * sizeof(std::uint64_t) + 1;
+        case op::sort_by: return depth - 3 * sizeof(std::uint64_t) + 1;
+
+        case op::hash_bytes: return depth - sizeof(std::uint64_t);
+
+        case op::span_sum:
+        case op::span_min:
+        case op::span_max: return depth - 2 * sizeof(std::uint64_t) + element_size(code, pos);
+        case op::span_count_eq: return depth - 2 * sizeof(std::uint64_t) - element_size(code, pos) + sizeof(std::uint64_t);
+        case op::span_dot: return depth - 4 * sizeof(std::uint64_t) + element_size(code, pos);
+        case op::span_add:
+        case op::span_mul: return depth - 6 * sizeof(std::uint64_t) + 1;
+        case op::span_scale: return depth - 4 * sizeof(std::uint64_t) - element_size(code, pos) + 1;
+
+        case op::spawn: return depth - operand(code, pos, 0);
+        case op::join: return depth - sizeof(std::uint64_t) + 1;
+        case op::atomic_load: return depth;
+        case op::atomic_store: return depth - sizeof(std::byte*) - sizeof(std::uint64_t) + 1;
+        case op::atomic_fetch_add: return depth - sizeof(std::byte*);
+        case op::parallel_for: return depth - 3 * sizeof(std::uint64_t) + 1;
+
+        case op::null_to_i64:
+        case op::null_to_u64: return depth - 1 + sizeof(std::uint64_t);
+        case op::bool_to_i64:
+        case op::bool_to_u64: return depth - sizeof(bool) + sizeof(std::uint64_t);
+        case op::char_to_i64:
+        case op::char_to_u64: return depth - sizeof(char) + sizeof(std::uint64_t);
+        case op::i32_to_i64:
+        case op::i32_to_u64: return depth - sizeof(std::int32_t) + sizeof(std::uint64_t);
+
+        case op::char_eq:
+        case op::char_ne: return depth - 2 * sizeof(char) + sizeof(bool);
+
+        case op::i32_add:
+        case op::i32_sub:
+        case op::i32_mul:
+        case op::i32_div:
+        case op::i32_mod: return depth - sizeof(std::int32_t);
+        case op::i32_eq:
+        case op::i32_ne:
+        case op::i32_lt:
+        case op::i32_le:
+        case op::i32_gt:
+        case op::i32_ge: return depth - 2 * sizeof(std::int32_t) + sizeof(bool);
+
+        case op::i64_add:
+        case op::i64_sub:
+        case op::i64_mul:
+        case op::i64_div:
+        case op::i64_mod:
+        case op::u64_add:
+        case op::u64_sub:
+        case op::u64_mul:
+        case op::u64_div:
+        case op::u64_mod:
+        case op::f64_add:
+        case op::f64_sub:
+        case op::f64_mul:
+        case op::f64_div: return depth - 8;
+        case op::i64_eq:
+        case op::i64_ne:
+        case op::i64_lt:
+        case op::i64_le:
+        case op::i64_gt:
+        case op::i64_ge:
+        case op::u64_eq:
+        case op::u64_ne:
+        case op::u64_lt:
+        case op::u64_le:
+        case op::u64_gt:
+        case op::u64_ge:
+        case op::f64_eq:
+        case op::f64_ne:
+        case op::f64_lt:
+        case op::f64_le:
+        case op::f64_gt:
+        case op::f64_ge: return depth - 2 * 8 + sizeof(bool);
+
+        case op::f64_pow:
+        case op::f64_min:
+        case op::f64_max: return depth - 8;
+        case op::f64_fma: return depth - 2 * 8;
+
+        case op::bool_eq:
+        case op::bool_ne: return depth - sizeof(bool);
+
+        case op::print_fmt: return depth - operand(code, pos, 2);
+
+        // These either leave the stack unchanged or replace a value with one of the same size
+        case op::span_ptr_to_len:
+        case op::arena_size:
+        case op::u64_to_i64:
+        case op::f64_to_i64:
+        case op::i64_to_u64:
+        case op::f64_to_u64:
+        case op::bool_not:
+        case op::i32_neg:
+        case op::i64_neg:
+        case op::f64_neg:
+        case op::f64_sqrt:
+        case op::f64_floor:
+        case op::f64_ceil:
+        case op::f64_round:
+        case op::f64_abs:
+        case op::f64_exp:
+        case op::f64_log:
+        case op::f64_sin:
+        case op::f64_cos: return depth;
+
+        // Control flow is followed by compute_depths itself
+        case op::end_program:
+        case op::jump:
+        case op::jump_if_true:
+        case op::jump_if_false:
+        case op::ret: break;
+    }
+    panic("depth_after: unexpected op {}", op_name(op_code));
+}
+
+// Computes the stack depth relative to the base pointer at the start of each instruction
+// by following every path through the function. Unreachable instructions are left as
+// unknown_depth. Returns an empty vector if the depths cannot be determined.
+auto compute_depths(const compiler& com, const std::vector<std::byte>& code, std::size_t entry_depth)
+    -> std::vector<std::size_t>
+{
+    auto depths = std::vector<std::size_t>(code.size(), unknown_depth);
+    auto pending = std::vector<std::size_t>{};
+
+    const auto visit = [&](std::size_t pos, std::size_t depth) {
+        if (pos >= code.size()) return true;
+        if (depths[pos] == unknown_depth) {
+            depths[pos] = depth;
+            pending.push_back(pos);
+            return true;
+        }
+        return depths[pos] == depth;
+    };
+
+    if (!visit(0, entry_depth)) return {};
+    while (!pending.empty()) {
+        const auto pos = pending.back();
+        pending.pop_back();
+        const auto depth = depths[pos];
+        const auto op_code = static_cast<op>(code[pos]);
+        const auto next = pos + sizeof(op) + op_operands_size(op_code);
+
+        auto consistent = true;
+        switch (op_code) {
+            case op::end_program:
+            case op::ret: break;
+            case op::jump: {
+                consistent = visit(operand(code, pos, 0), depth);
+            } break;
+            case op::jump_if_true:
+            case op::jump_if_false: {
+                consistent = visit(next, depth - sizeof(bool))
+                          && visit(operand(code, pos, 0), depth - sizeof(bool));
+            } break;
+            default: {
+                consistent = visit(next, depth_after(com, code, pos, depth));
+            } break;
+        }
+        if (!consistent) return {};
+    }
+    return depths;
+}
+
+auto is_inlinable(const compiler& com, std::size_t callee) -> bool
+{
+    // Functions still being compiled (including recursive calls) are incomplete
+    if (std::ranges::find(com.current_function, callee) != com.current_function.end()) {
+        return false;
+    }
+    return com.functions[callee].code.size() <= max_inline_size;
+}
+
+// Returns the end of the reachable code in a function body. The scope cleanup emitted after
+// a final return can never run, so there is no need to copy it into the call site.
+auto body_end(const std::vector<std::byte>& code) -> std::size_t
+{
+    auto end = code.size();
+    auto max_target = std::size_t{0};
+    for (std::size_t pos = 0; pos < code.size();) {
+        const auto op_code = static_cast<op>(code[pos]);
+        const auto next = pos + sizeof(op) + op_operands_size(op_code);
+        if (is_jump(op_code)) {
+            max_target = std::max(max_target, static_cast<std::size_t>(operand(code, pos, 0)));
+        }
+        if (op_code == op::ret) {
+            end = next;
+        } else if (op_code != op::pop) {
+            end = code.size();
+        }
+        pos = next;
+    }
+    return max_target < end ? end : code.size();
+}
+
+// Appends the code of a function such that it runs within the caller's frame, with the
+// callee's base pointer at the given offset. Returns are rewritten to move the return
+// value down to the base of the inlined frame and then jump past the inlined code. The
+// callee's line table is carried over so that the inlined code maps to the callee's source.
+auto append_inlined(
+    std::vector<std::byte>& out,
+    std::vector<line_entry>& out_lines,
+    const std::vector<std::byte>& code,
+    const std::vector<line_entry>& lines,
+    std::size_t base
+)
+    -> void
+{
+    const auto end = body_end(code);
+    auto new_offsets = std::vector<std::size_t>(end + 1);
+    auto jumps = std::vector<std::size_t>{};
+    auto exits = std::vector<std::size_t>{};
+
+    for (std::size_t pos = 0; pos < end;) {
+        new_offsets[pos] = out.size();
+        const auto op_code = static_cast<op>(code[pos]);
+        const auto next = pos + sizeof(op) + op_operands_size(op_code);
+        switch (op_code) {
+            case op::push_ptr_local: {
+                push_value(out, op::push_ptr_local, operand(code, pos, 0) + base);
+            } break;
+            case op::push_val_local: {
+                push_value(out, op::push_val_local, operand(code, pos, 0) + base, operand(code, pos, 1));
+            } break;
+            case op::inline_ret: {
+                push_value(out, op::inline_ret, operand(code, pos, 0) + base, operand(code, pos, 1));
+            } break;
+            case op::ret: {
+                push_value(out, op::inline_ret, std::uint64_t{base}, operand(code, pos, 0));
+                if (next != end) {
+                    push_value(out, op::jump);
+                    exits.push_back(push_value(out, std::uint64_t{0}));
+                }
+            } break;
+            case op::jump:
+            case op::jump_if_true:
+            case op::jump_if_false: {
+                push_value(out, op_code);
+                jumps.push_back(push_value(out, operand(code, pos, 0)));
+            } break;
+            default: {
+                out.insert(out.end(), code.begin() + pos, code.begin() + next);
+            } break;
+        }
+        pos = next;
+    }
+    new_offsets[end] = out.size();
+
+    for (const auto jump : jumps) {
+        const auto target = read_at<std::uint64_t>(out, jump);
+        write_value(out, jump, static_cast<std::uint64_t>(new_offsets[target]));
+    }
+    for (const auto& entry : lines) {
+        if (entry.offset >= end) break;
+        const auto offset = static_cast<std::uint32_t>(new_offsets[entry.offset]);
+        add_line(out_lines, {offset, entry.module, entry.line});
+    }
+    for (const auto exit : exits) {
+        write_value(out, exit, static_cast<std::uint64_t>(out.size()));
+    }
+}
+
+}
+
+auto inline_small_functions(compiler& com, std::size_t id, std::size_t entry_depth) -> void
+{
+    const auto& code = com.functions[id].code;
+    const auto& lines = com.functions[id].lines;
+    const auto depths = compute_depths(com, code, entry_depth);
+    if (depths.empty()) return;
+
+    auto out = std::vector<std::byte>{};
+    auto out_lines = std::vector<line_entry>{};
+    auto new_offsets = std::vector<std::size_t>(code.size() + 1);
+    auto jumps = std::vector<std::size_t>{};
+    auto changed = false;
+
+    auto line = lines.begin();
+    const auto copy_lines_up_to = [&](std::size_t pos) {
+        for (; line != lines.end() && line->offset <= pos; ++line) {
+            add_line(out_lines, {static_cast<std::uint32_t>(out.size()), line->module, line->line});
+        }
+    };
+
+    for (std::size_t pos = 0; pos < code.size();) {
+        new_offsets[pos] = out.size();
+        copy_lines_up_to(pos);
+        const auto op_code = static_cast<op>(code[pos]);
+        const auto next = pos + sizeof(op) + op_operands_size(op_code);
+
+        if (op_code == op::call_static && depths[pos] != unknown_depth) {
+            const auto callee = operand(code, pos, 0);
+            const auto args_size = operand(code, pos, 1);
+            if (is_inlinable(com, callee)) {
+                const auto& function = com.functions[callee];
+                append_inlined(out, out_lines, function.code, function.lines, depths[pos] - args_size);
+                if (const auto caller_line = find_line(lines, pos)) { // back to the caller's line
+                    const auto offset = static_cast<std::uint32_t>(out.size());
+                    add_line(out_lines, {offset, caller_line->module, caller_line->line});
+                }
+                changed = true;
+                pos = next;
+                continue;
+            }
+        }
+
+        if (is_jump(op_code)) {
+            jumps.push_back(out.size() + sizeof(op));
+        }
+        out.insert(out.end(), code.begin() + pos, code.begin() + next);
+        pos = next;
+    }
+    new_offsets[code.size()] = out.size();
+    copy_lines_up_to(code.size());
+
+    if (!changed) return;
+    for (const auto jump : jumps) {
+        const auto target = read_at<std::uint64_t>(out, jump);
+        write_value(out, jump, static_cast<std::uint64_t>(new_offsets[target]));
+    }
+    com.functions[id].code = std::move(out);
+    com.functions[id].lines = std::move(out_lines);
+}
+
+}
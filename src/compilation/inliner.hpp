@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+namespace anzu {
+
+struct compiler;
+
+// Replaces static calls to small, fully compiled functions with a copy of the callee's
+// bytecode, rebasing its locals into the caller's frame. The entry depth is the number
+// of bytes on the stack above the base pointer when the function starts, ie- its params.
+auto inline_small_functions(compiler& com, std::size_t id, std::size_t entry_depth) -> void;
+
+}
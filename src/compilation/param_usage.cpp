@@ -0,0 +1,190 @@
+#include "param_usage.hpp"
+#include "utility/common.hpp"
+
+namespace anzu {
+namespace {
+
+auto modifies(const node_expr& node, const std::string& name) -> bool;
+auto modifies(const node_stmt& node, const std::string& name) -> bool;
+
+auto modifies(const node_expr_ptr& node, const std::string& name) -> bool
+{
+    return node && modifies(*node, name);
+}
+
+auto modifies(const node_stmt_ptr& node, const std::string& name) -> bool
+{
+    return node && modifies(*node, name);
+}
+
+auto modifies(const std::vector<node_expr_ptr>& nodes, const std::string& name) -> bool
+{
+    for (const auto& node : nodes) {
+        if (modifies(node, name)) return true;
+    }
+    return false;
+}
+
+// True if the expression refers to the variable itself or to a part of it, ie- writing
+// to or taking the address of this expression could modify the variable
+auto refers_to(const node_expr& node, const std::string& name) -> bool
+{
+    return std::visit(overloaded{
+        [&](const node_name_expr& n)      { return n.name == name; },
+        [&](const node_field_expr& n)     { return refers_to(*n.expr, name); },
+        [&](const node_subscript_expr& n) { return refers_to(*n.expr, name); },
+        [&](const node_const_expr& n)     { return refers_to(*n.expr, name); },
+        [&](const auto&)                  { return false; }
+    }, node);
+}
+
+auto modifies(const node_expr& node, const std::string& name) -> bool
+{
+    return std::visit(overloaded{
+        [&](const node_unary_op_expr& n) { return modifies(n.expr, name); },
+        [&](const node_binary_op_expr& n) {
+            return modifies(n.lhs, name) || modifies(n.rhs, name);
+        },
+        [&](const node_call_expr& n) {
+            // Member functions may bind a non-const pointer to the instance
+            if (std::holds_alternative<node_field_expr>(*n.expr) && refers_to(*n.expr, name)) {
+                return true;
+            }
+            return modifies(n.expr, name) || modifies(n.args, name);
+        },
+        [&](const node_template_expr& n) { return modifies(n.expr, name); },
+        [&](const node_array_expr& n) { return modifies(n.elements, name); },
+        [&](const node_repeat_array_expr& n) { return modifies(n.value, name); },
+        [&](const node_addrof_expr& n) {
+            return refers_to(*n.expr, name) || modifies(n.expr, name);
+        },
+        [&](const node_span_expr& n) {
+            return refers_to(*n.expr, name) || modifies(n.expr, name)
+                || modifies(n.lower_bound, name) || modifies(n.upper_bound, name);
+        },
+        [&](const node_const_expr& n) { return modifies(n.expr, name); },
+        [&](const node_field_expr& n) { return modifies(n.expr, name); },
+        [&](const node_deref_expr& n) { return modifies(n.expr, name); },
+        [&](const node_subscript_expr& n) {
+            return modifies(n.expr, name) || modifies(n.index, name);
+        },
+        [&](const node_new_expr& n) {
+            return modifies(n.arena, name) || modifies(n.count, name)
+                || modifies(n.original, name) || modifies(n.expr, name);
+        },
+        [&](const node_ternary_expr& n) {
+            return modifies(n.condition, name) || modifies(n.true_case, name)
+                || modifies(n.false_case, name);
+        },
+        [&](const node_intrinsic_expr& n) {
+            // Intrinsics may take the address of their arguments
+            for (const auto& arg : n.args) {
+                if (refers_to(*arg, name) || modifies(arg, name)) return true;
+            }
+            return false;
+        },
+        [&](const node_as_expr& n) { return modifies(n.expr, name); },
+        [&](const auto&) { return false; }
+    }, node);
+}
+
+auto modifies(const node_stmt& node, const std::string& name) -> bool
+{
+    return std::visit(overloaded{
+        [&](const node_sequence_stmt& n) {
+            for (const auto& stmt : n.sequence) {
+                if (modifies(stmt, name)) return true;
+            }
+            return false;
+        },
+        [&](const node_loop_stmt& n) { return modifies(n.body, name); },
+        [&](const node_while_stmt& n) {
+            return modifies(n.condition, name) || modifies(n.body, name);
+        },
+        [&](const node_for_stmt& n) {
+            return (n.is_ptr && refers_to(*n.iter, name))
+                || modifies(n.iter, name) || modifies(n.body, name);
+        },
+        [&](const node_if_stmt& n) {
+            return modifies(n.condition, name) || modifies(n.body, name)
+                || modifies(n.else_body, name);
+        },
+        [&](const node_declaration_stmt& n) { return modifies(n.expr, name); },
+        [&](const node_assignment_stmt& n) {
+            return refers_to(*n.position, name) || modifies(n.position, name)
+                || modifies(n.expr, name);
+        },
+        [&](const node_expression_stmt& n) { return modifies(n.expr, name); },
+        [&](const node_return_stmt& n) { return modifies(n.return_value, name); },
+        [&](const node_assert_stmt& n) { return modifies(n.expr, name); },
+        [&](const node_print_stmt& n) { return modifies(n.args, name); },
+
+        // Nested functions and structs cannot access the enclosing function's variables
+        [&](const auto&) { return false; }
+    }, node);
+}
+
+auto calls(const node_expr& node) -> bool;
+
+auto calls(const node_expr_ptr& node) -> bool
+{
+    return node && calls(*node);
+}
+
+auto calls(const std::vector<node_expr_ptr>& nodes) -> bool
+{
+    for (const auto& node : nodes) {
+        if (calls(node)) return true;
+    }
+    return false;
+}
+
+auto calls(const node_expr& node) -> bool
+{
+    return std::visit(overloaded{
+        [&](const node_call_expr&) { return true; },
+        [&](const node_intrinsic_expr& n) {
+            // @len calls the len member function of structs, and the threads ones run
+            // functions or wait for them to finish
+            if (n.name == "len" || n.name == "parallel_for" || n.name == "spawn" || n.name == "join") {
+                return true;
+            }
+            return calls(n.args);
+        },
+        [&](const node_unary_op_expr& n) { return calls(n.expr); },
+        [&](const node_binary_op_expr& n) { return calls(n.lhs) || calls(n.rhs); },
+        [&](const node_template_expr& n) { return calls(n.expr); },
+        [&](const node_array_expr& n) { return calls(n.elements); },
+        [&](const node_repeat_array_expr& n) { return calls(n.value); },
+        [&](const node_addrof_expr& n) { return calls(n.expr); },
+        [&](const node_deref_expr& n) { return calls(n.expr); },
+        [&](const node_field_expr& n) { return calls(n.expr); },
+        [&](const node_const_expr& n) { return calls(n.expr); },
+        [&](const node_subscript_expr& n) { return calls(n.expr) || calls(n.index); },
+        [&](const node_span_expr& n) {
+            return calls(n.expr) || calls(n.lower_bound) || calls(n.upper_bound);
+        },
+        [&](const node_new_expr& n) {
+            return calls(n.arena) || calls(n.count) || calls(n.original) || calls(n.expr);
+        },
+        [&](const node_ternary_expr& n) {
+            return calls(n.condition) || calls(n.true_case) || calls(n.false_case);
+        },
+        [&](const node_as_expr& n) { return calls(n.expr); },
+        [&](const auto&) { return false; }
+    }, node);
+}
+
+}
+
+auto may_modify(const node_stmt& body, const std::string& name) -> bool
+{
+    return modifies(body, name);
+}
+
+auto may_call(const node_expr& expr) -> bool
+{
+    return calls(expr);
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "ast.hpp"
+
+#include <string>
+
+namespace anzu {
+
+// Conservatively checks if a function body may modify the variable with the given name,
+// either directly via assignment or indirectly by taking its address. Names that are
+// shadowed by local declarations are treated as the same variable.
+auto may_modify(const node_stmt& body, const std::string& name) -> bool;
+
+// Conservatively checks if evaluating the expression may call a function of the program,
+// which could have side effects such as printing
+auto may_call(const node_expr& expr) -> bool;
+
+}
@@ -34,7 +34,8 @@ auto variable_manager::declare(
     const std::string& name,
     const type_name& type,
     std::size_t size,
-    const const_value& value
+    const const_value& value,
+    bool by_ref
 ) -> bool
 {
     auto& scope = d_scopes.back();
@@ -43,11 +44,21 @@ auto variable_manager::declare(
     }
 
     // Only store the compile time value (if it exists) for const values
-    scope.variables.emplace_back(module, name, type, scope.next, size, type.is_const ? value : const_value{});
+    scope.variables.emplace_back(module, name, type, scope.next, size, type.is_const ? value : const_value{}, by_ref);
     scope.next += size;
     return true;
 }
 
+auto variable_manager::align_next(std::vector<std::byte>& code, std::size_t alignment) -> void
+{
+    auto& scope = d_scopes.back();
+    const auto padding = (alignment - scope.next % alignment) % alignment;
+    if (padding > 0) {
+        push_value(code, op::push, padding);
+        scope.next += padding;
+    }
+}
+
 auto variable_manager::find(const std::filesystem::path& module, const std::string& name) const -> std::optional<variable>
 {
     for (const auto& scope : d_scopes | std::views::reverse) {
@@ -24,6 +24,7 @@ struct variable
     std::size_t           location;
     std::size_t           size;
     const_value           value;
+    bool                  by_ref = false; // the slot holds a pointer to the object
 };
 
 struct simple_scope
@@ -59,9 +60,14 @@ public:
         const std::string& name,
         const type_name& type,
         std::size_t size,
-        const const_value& value
+        const const_value& value,
+        bool by_ref = false
     ) -> bool;
 
+    // Pushes padding so that the next variable declared in the current scope starts at a
+    // multiple of the given alignment from the start of the frame
+    auto align_next(std::vector<std::byte>& code, std::size_t alignment) -> void;
+
     auto find(const std::filesystem::path& module, const std::string& name) const -> std::optional<variable>;
     auto scopes() const -> std::span<const scope> { return d_scopes; }
 
@@ -3,6 +3,8 @@
 #include "lexer.hpp"
 #include "object.hpp"
 #include "parser.hpp"
+#include "compilation/inliner.hpp"
+#include "compilation/param_usage.hpp"
 #include "utility/common.hpp"
 #include "utility/memory.hpp"
 
@@ -65,6 +67,7 @@ enum class compile_type { val, ptr };
 auto push_expr(compiler& com, compile_type ct, const node_expr& node) -> expr_result;
 auto push_stmt(compiler& com, const node_stmt& root) -> void;
 auto type_of_expr(compiler& com, const node_expr& node) -> expr_result;
+auto function_ptr_id(compiler& com, std::size_t id) -> std::size_t;
 
 auto get_fundamental_type(const std::string& name) -> std::optional<type_name>
 {
@@ -123,6 +126,18 @@ auto resolve_types(compiler& com, const token& tok, const std::vector<node_expr_
     return templates;
 }
 
+// The alignment of variables of the given type relative to the start of their frame. Numeric
+// scalars, and arrays of them, are naturally aligned so that they can be used with atomic ops
+// and the span kernels. The global frame and the frames of functions started on a new thread
+// begin at the start of a stack, so for those the alignment is absolute.
+auto slot_alignment(const type_name& type) -> std::size_t
+{
+    if (type.is<type_array>()) return slot_alignment(*type.as<type_array>().inner_type);
+    if (type.is<type_i32>()) return sizeof(std::int32_t);
+    if (type.is<type_i64>() || type.is<type_u64>() || type.is<type_f64>()) return sizeof(std::uint64_t);
+    return 1;
+}
+
 // Registers the given name in the current scope
 void declare_var(
     compiler& com,
@@ -137,11 +152,25 @@ void declare_var(
     }
 }
 
+// Params of these types above this size are passed as a pointer to the argument if the
+// function never modifies them, to avoid copying large objects on every call
+constexpr auto by_ref_threshold = std::size_t{32};
+
+auto pass_by_ref(const compiler& com, const type_name& type) -> bool
+{
+    return (type.is<type_struct>() || type.is<type_array>())
+        && com.types.size_of(type) > by_ref_threshold;
+}
+
 auto push_var_addr(compiler& com, const token& tok, const std::filesystem::path& module, const std::string& name) -> expr_result
 {
     if (in_function(com)) {
         if (const auto var = variables(com).find(module, name); var.has_value()) {
-            push_value(code(com), op::push_ptr_local, var->location);
+            if (var->by_ref) {
+                push_value(code(com), op::push_val_local, var->location, sizeof(std::byte*));
+            } else {
+                push_value(code(com), op::push_ptr_local, var->location);
+            }
             return {var->type};
         }
     }
@@ -157,7 +186,10 @@ auto push_var_val(compiler& com, const token& tok, const std::filesystem::path&
     if (in_function(com)) {
         if (const auto var = variables(com).find(module, name); var.has_value()) {
             const auto size = com.types.size_of(var->type);
-            if (size > 0) {
+            if (var->by_ref) {
+                push_value(code(com), op::push_val_local, var->location, sizeof(std::byte*));
+                push_value(code(com), op::load, size);
+            } else if (size > 0) {
                 push_value(code(com), op::push_val_local, var->location, size);
             }
             return { var->type, var->value };
@@ -300,7 +332,7 @@ void push_copy_typechecked(compiler& com, const node_expr& expr, const type_name
 
     // Let functions convert to function ptrs
     if (auto func = actual.get_if<type_function>(); func && func->to_pointer() == expected) {
-        push_value(code(com), op::push_function_ptr, func->id); // push the id
+        push_value(code(com), op::push_function_ptr, function_ptr_id(com, func->id)); // push the id
         return;
     }
 
@@ -445,6 +477,7 @@ auto compile_function(
     com.current_struct.emplace_back(name.struct_name);
     com.current_module.emplace_back(name.module);
     com.functions.emplace_back(name, id, variable_manager{true}, map);
+    current(com).body = body.get();
     const auto [it, success] = com.functions_by_name.emplace(name, id);
     tok.assert(success, "a function with the name '{}' already exists", name);
     
@@ -452,8 +485,15 @@ auto compile_function(
 
     for (const auto& arg : ast_params) {
         const auto type = resolve_type(com, tok, arg.type);
-        declare_var(com, tok, arg.name, type);
+        const auto by_ref = pass_by_ref(com, type) && !may_modify(*body, arg.name);
+        if (by_ref) {
+            const auto success = variables(com).declare(curr_module(com), arg.name, type, sizeof(std::byte*), {}, true);
+            tok.assert(success, "name already in use: '{}'", arg.name);
+        } else {
+            declare_var(com, tok, arg.name, type);
+        }
         current(com).params.push_back(type);
+        current(com).by_ref_params.push_back(by_ref);
     }
     const auto return_type = ast_return_type ? resolve_type(com, tok, ast_return_type) : type_name{type_null{}};
     current(com).return_type = return_type;
@@ -471,6 +511,13 @@ auto compile_function(
     }
 
     variables(com).pop_scope(code(com));
+    if (com.options.inline_functions) {
+        auto params_size = std::size_t{0};
+        for (const auto& [param, by_ref] : std::views::zip(current(com).params, current(com).by_ref_params)) {
+            params_size += by_ref ? sizeof(std::byte*) : com.types.size_of(param);
+        }
+        inline_small_functions(com, id, params_size);
+    }
     com.current_function.pop_back();
     com.current_struct.pop_back();
     com.current_module.pop_back();
@@ -505,26 +552,54 @@ auto string_split(std::string s, std::string_view delimiter) -> std::vector<std:
     return res;
 }
 
-auto push_print_fundamental(compiler& com, const node_expr& node, const token& tok) -> void
+// Returns the key that op::sort and op::sort_by should compare values of the given type as
+auto sort_key_of(const token& tok, const type_name& type) -> sort_key
 {
-    const auto type = push_expr(com, compile_type::val, node).type;
-    std::visit(overloaded{
-        [&] (type_null)          { push_value(code(com), op::print_null); },
-        [&] (type_bool)          { push_value(code(com), op::print_bool); },
-        [&] (type_char)          { push_value(code(com), op::print_char); },
-        [&] (type_i32)           { push_value(code(com), op::print_i32);  },
-        [&] (type_i64)           { push_value(code(com), op::print_i64);  },
-        [&] (type_u64)           { push_value(code(com), op::print_u64);  },
-        [&] (type_f64)           { push_value(code(com), op::print_f64);  },
-        [&] (const type_ptr&)    { push_value(code(com), op::print_ptr);  },
+    return std::visit(overloaded{
+        [&] (type_bool) { return sort_key::bool_key; },
+        [&] (type_char) { return sort_key::char_key; },
+        [&] (type_i32)  { return sort_key::i32_key;  },
+        [&] (type_i64)  { return sort_key::i64_key;  },
+        [&] (type_u64)  { return sort_key::u64_key;  },
+        [&] (type_f64)  { return sort_key::f64_key;  },
+        [&] (auto&&) -> sort_key {
+            tok.error("cannot sort by value of type {}", type);
+        }
+    }, type);
+}
+
+auto numeric_type_of(const token& tok, const type_name& type) -> numeric_type
+{
+    return std::visit(overloaded{
+        [&] (type_i32) { return numeric_type::i32_type; },
+        [&] (type_i64) { return numeric_type::i64_type; },
+        [&] (type_u64) { return numeric_type::u64_type; },
+        [&] (type_f64) { return numeric_type::f64_type; },
+        [&] (auto&&) -> numeric_type {
+            tok.error("span operations require elements of type i32, i64, u64 or f64, got '{}'", type);
+        }
+    }, type);
+}
+
+// Returns how op::print_fmt should print a value of the given type
+auto print_part_of(const token& tok, const type_name& type) -> print_part
+{
+    return std::visit(overloaded{
+        [&] (type_null)          { return print_part::null_value; },
+        [&] (type_bool)          { return print_part::bool_value; },
+        [&] (type_char)          { return print_part::char_value; },
+        [&] (type_i32)           { return print_part::i32_value;  },
+        [&] (type_i64)           { return print_part::i64_value;  },
+        [&] (type_u64)           { return print_part::u64_value;  },
+        [&] (type_f64)           { return print_part::f64_value;  },
+        [&] (const type_ptr&)    { return print_part::ptr_value;  },
         [&] (const type_span& t) {
-            if (t.inner_type->is<type_char>()) {
-                push_value(code(com), op::print_char_span);
-            } else {
+            if (!t.inner_type->is<type_char>()) {
                 tok.error("cannot print value of type {}", type);
             }
+            return print_part::char_span_value;
         },
-        [&] (auto&&) {
+        [&] (auto&&) -> print_part {
             tok.error("cannot print value of type {}", type);
         }
     }, type);
@@ -557,10 +632,10 @@ auto load_module(compiler& com, const token& tok, const std::string& filepath) -
     // Add as an available module to the current module, and check for circular deps
     for (const auto& m : com.current_module | std::views::reverse) {
         if (m == filepath) {
-            std::print("circular dependencey detected:\n");
+            auto chain = std::string{};
             for (const auto& mod : com.current_module | std::views::reverse) {
-                std::print("  - {}\n", mod.string());
-                if (mod == m) tok.error("circular dependency");
+                chain += std::format("\n  - {}", mod.string());
+                if (mod == m) tok.error("circular dependency detected:{}", chain);
             }
         }
     }
@@ -570,22 +645,27 @@ auto load_module(compiler& com, const token& tok, const std::string& filepath) -
         return; 
     }
 
-    // Second, parse the module into its AST
-    const auto path = std::filesystem::absolute(filepath);
-    std::print("    - Parsing {}\n", filepath);
-    const auto mod = parse(path);
+    // Second, fetch the AST of the module. These are normally parsed up front by parse_imports
+    // but we fall back to parsing here for any that were missed.
+    if (com.options.verbose) std::print("    - Parsing {}\n", filepath);
+    if (!com.parsed_modules.contains(filepath)) {
+        com.parsed_modules.emplace(filepath, parse(std::filesystem::absolute(filepath)));
+    }
+    const auto& mod = com.parsed_modules.at(filepath);
 
+    const auto timer = stopwatch{};
     com.current_module.emplace_back(filepath);
     // We must unwrap the sequence statement like this since we do no want to introduce a new
     // scope while compiling this, otherwise all the variables will get popped after.
     tok.assert(std::holds_alternative<node_sequence_stmt>(*mod.root), "invalid module, top level must be a sequence");
-    std::print("    - Compiling {}\n", filepath);
+    if (com.options.verbose) std::print("    - Compiling {}\n", filepath);
     for (const auto& node : std::get<node_sequence_stmt>(*mod.root).sequence) {
         push_stmt(com, *node);
     }
     com.current_module.pop_back();
     com.modules.emplace(filepath);
-    std::print("    - Completed {}\n", filepath);
+    com.stats.module_seconds.emplace_back(filepath, timer.seconds());
+    if (com.options.verbose) std::print("    - Completed {}\n", filepath);
 }
 
 auto fetch_function(compiler& com, const token& tok, const function_name& name) -> type_function
@@ -597,6 +677,7 @@ auto fetch_function(compiler& com, const token& tok, const function_name& name)
         const auto& ast = com.function_templates.at(key);
         const auto map = build_template_map(com, tok, ast.templates, name.templates);
         compile_function(com, tok, name, ast.params, ast.return_type, ast.body, map);
+        ++com.stats.function_instantiations;
     }
 
     tok.assert(com.functions_by_name.contains(name), "could not find function {}\n", name);
@@ -615,6 +696,166 @@ auto push_args_typechecked(compiler& com, const token& tok, const auto& args, co
     return args_size;
 }
 
+// True if the expression is a local variable, or a field or array element of one, that the
+// current function never assigns to or takes the address of. Nothing else can write to such
+// an object, so a callee cannot tell if it gets a pointer to it rather than a copy.
+auto is_unmodified_local(compiler& com, const node_expr& expr) -> bool
+{
+    if (!in_function(com) || !current(com).body) return false;
+    return std::visit(overloaded{
+        [&](const node_name_expr& n) {
+            return variables(com).find(curr_module(com), n.name).has_value()
+                && !may_modify(*current(com).body, n.name);
+        },
+        [&](const node_field_expr& n) {
+            return type_of_expr(com, *n.expr).type.is<type_struct>()
+                && is_unmodified_local(com, *n.expr);
+        },
+        [&](const node_subscript_expr& n) {
+            return type_of_expr(com, *n.expr).type.is<type_array>()
+                && is_unmodified_local(com, *n.expr);
+        },
+        [&](const auto&) { return false; }
+    }, expr);
+}
+
+// Params that a function takes by reference get a pointer to the argument. Unless the argument
+// is a local that cannot change during the call, it is first copied to a temporary, since the
+// callee could otherwise see writes made to the argument through a global or another pointer
+// while it runs.
+auto needs_temp(compiler& com, const node_expr& arg, std::size_t id, std::size_t param) -> bool
+{
+    return com.functions[id].by_ref_params[param] && !is_unmodified_local(com, arg);
+}
+
+// Reserves space in the caller's frame for the temporaries of a call to the given function,
+// starting at the given param. This must come before anything else for the call is pushed
+// so that the temporaries sit below the args and outlive the call. Returns the size reserved.
+auto reserve_temps(compiler& com, const auto& args, std::size_t id, std::size_t first_param) -> std::size_t
+{
+    auto temps_size = std::size_t{0};
+    for (std::size_t i = 0; i != args.size() && first_param + i < com.functions[id].params.size(); ++i) {
+        if (needs_temp(com, *args[i], id, first_param + i)) {
+            temps_size += com.types.size_of(com.functions[id].params[first_param + i]);
+        }
+    }
+    if (temps_size > 0) {
+        push_value(code(com), op::push, temps_size);
+    }
+    return temps_size;
+}
+
+// Releases the temporaries of a call once it has returned, moving the return value down
+auto release_temps(compiler& com, std::size_t temps_size, const type_name& return_type) -> void
+{
+    if (temps_size > 0) {
+        push_value(code(com), op::pop_temps, temps_size, com.types.size_of(return_type));
+    }
+}
+
+// Pushes the args for a call to the given function, starting at the given param, and returns
+// their size. By-ref args that need a temporary are copied into the space from reserve_temps.
+auto push_call_args(
+    compiler& com,
+    const token& tok,
+    const auto& args,
+    std::size_t id,
+    std::size_t first_param,
+    std::size_t temps_size
+)
+    -> std::size_t
+{
+    // Copy, since compiling the args can compile other functions
+    const auto params = com.functions[id].params;
+    const auto by_ref_params = com.functions[id].by_ref_params;
+    tok.assert_eq(args.size(), params.size() - first_param, "invalid number of args for function call");
+
+    // The earlier params, ie- the instance for member functions, are already pushed
+    auto pushed = std::size_t{0};
+    for (std::size_t i = 0; i != first_param; ++i) {
+        pushed += com.types.size_of(params[i]);
+    }
+
+    auto args_size = std::size_t{0};
+    auto temps_used = std::size_t{0};
+    for (std::size_t i = 0; i != args.size(); ++i) {
+        const auto& arg = *args[i];
+        const auto& type = params[first_param + i];
+        if (!by_ref_params[first_param + i]) {
+            push_copy_typechecked(com, arg, type, tok);
+            args_size += com.types.size_of(type);
+            continue;
+        }
+
+        const auto actual = type_of_expr(com, arg).type;
+        if (!const_convertable_to(tok, actual.remove_const(), type.remove_const())) {
+            tok.error("Cannot convert '{}' to '{}'", actual, type);
+        }
+        if (needs_temp(com, arg, id, first_param + i)) {
+            // The temporary is this far below the value, past the args pushed so far and
+            // the rest of the reserved space
+            const auto size = com.types.size_of(type);
+            const auto distance = pushed + args_size + temps_size - temps_used;
+            push_expr(com, compile_type::val, arg);
+            push_value(code(com), op::push_temp, size, distance);
+            temps_used += size;
+        } else {
+            push_expr(com, compile_type::ptr, arg);
+        }
+        args_size += sizeof(std::byte*);
+    }
+    return args_size;
+}
+
+auto push_call_static(compiler& com, const token& tok, const auto& args, std::size_t id) -> void
+{
+    const auto temps_size = reserve_temps(com, args, id, 0);
+    const auto args_size = push_call_args(com, tok, args, id, 0, temps_size);
+    push_value(code(com), op::call_static, id, args_size);
+    release_temps(com, temps_size, com.functions[id].return_type);
+}
+
+// Returns a function that can be called through a function pointer. Calls via function
+// pointers always pass args by value, so functions with by-ref params get wrapped in a
+// function that forwards pointers to its own params.
+auto function_ptr_id(compiler& com, std::size_t id) -> std::size_t
+{
+    const auto by_ref_params = com.functions[id].by_ref_params;
+    if (std::ranges::find(by_ref_params, true) == by_ref_params.end()) {
+        return id;
+    }
+    if (const auto it = com.by_value_thunks.find(id); it != com.by_value_thunks.end()) {
+        return it->second;
+    }
+
+    const auto thunk_id = com.functions.size();
+    auto name = com.functions[id].name;
+    name.name += "$by_value";
+    com.functions.emplace_back(name, thunk_id, variable_manager{true}, com.functions[id].templates);
+    const auto& func = com.functions[id];
+    auto& thunk = com.functions.back();
+    thunk.params = func.params;
+    thunk.by_ref_params.resize(func.params.size(), false);
+    thunk.return_type = func.return_type;
+
+    auto offset = std::size_t{0};
+    auto args_size = std::size_t{0};
+    for (const auto& [param, by_ref] : std::views::zip(func.params, func.by_ref_params)) {
+        const auto size = com.types.size_of(param);
+        if (by_ref) {
+            push_value(thunk.code, op::push_ptr_local, offset);
+            args_size += sizeof(std::byte*);
+        } else if (size > 0) {
+            push_value(thunk.code, op::push_val_local, offset, size);
+            args_size += size;
+        }
+        offset += size;
+    }
+    push_value(thunk.code, op::call_static, id, args_size, op::ret, com.types.size_of(func.return_type));
+    com.by_value_thunks.emplace(id, thunk_id);
+    return thunk_id;
+}
+
 auto compile_struct_template(
     compiler& com,
     const token& tok,
@@ -628,6 +869,7 @@ auto compile_struct_template(
     com.current_module.emplace_back(name.module);
     const auto success = com.types.add_type(name, map);
     tok.assert(success, "multiple definitions for struct {} found", name);
+    ++com.stats.struct_instantiations;
     for (const auto& p : stmt.fields) {
         const auto f = type_field{p.name, resolve_type(com, tok, p.type)};
         com.types.add_field(name, f);
@@ -972,12 +1214,11 @@ auto push_expr(compiler& com, compile_type ct, const node_call_expr& node) -> ex
     else if (auto info = type.get_if<type_function_ptr>()) {
         const auto args_size = push_args_typechecked(com, node.token, node.args, info->param_types);
         push_expr(com, compile_type::val, *node.expr);
-        push_value(code(com), op::call_ptr, args_size);
+        push_value(code(com), op::call_ptr, args_size, com.types.size_of(*info->return_type));
         return { *info->return_type };
     }
     else if (auto info = type.get_if<type_function>()) {
-        const auto args_size = push_args_typechecked(com, node.token, node.args, info->param_types);
-        push_value(code(com), op::call_static, info->id, args_size);
+        push_call_static(com, node.token, node.args, info->id);
         return { *info->return_type };
     }
     else if (auto info = type.get_if<type_function_template>()) {
@@ -988,18 +1229,17 @@ auto push_expr(compiler& com, compile_type ct, const node_call_expr& node) -> ex
         const auto templates = deduce_template_params(com, node.token, ast.templates, params, node.args);
         const auto name = function_name{ info->module, info->struct_name, info->name, templates };
         const auto func = fetch_function(com, node.token, name);
-        
-        const auto args_size = push_args_typechecked(com, node.token, node.args, func.param_types);
-        push_value(code(com), op::call_static, func.id, args_size);
+        push_call_static(com, node.token, node.args, func.id);
         return { *func.return_type };
     }
     else if (auto info = type.get_if<type_bound_method>()) { // member function call
         // cannot use push_copy_typechecked because the types mismatch, but the bound method
         // type just wraps a pointer to the instance, so this is fine
+        const auto temps_size = reserve_temps(com, node.args, info->id, 1);
         push_expr(com, compile_type::val, *node.expr);
-        auto args_size = com.types.size_of(info->param_types[0]);
-        args_size += push_args_typechecked(com, node.token, node.args, info->param_types | std::views::drop(1));
-        push_value(code(com), op::call_static, info->id, args_size);
+        const auto args_size = push_call_args(com, node.token, node.args, info->id, 1, temps_size);
+        push_value(code(com), op::call_static, info->id, com.types.size_of(info->param_types[0]) + args_size);
+        release_temps(com, temps_size, *info->return_type);
         return { *info->return_type };
     }
     else if (auto info = type.get_if<type_bound_method_template>()) { // member function call
@@ -1016,11 +1256,12 @@ auto push_expr(compiler& com, compile_type ct, const node_call_expr& node) -> ex
 
         // cannot use push_copy_typechecked because the types mismatch, but the bound method
         // type just wraps a pointer to the instance, so this is fine
+        const auto temps_size = reserve_temps(com, node.args, func.id, 1);
         push_expr(com, compile_type::val, *node.expr); // push pointer to the instance to bind to
 
-        auto args_size = com.types.size_of(func.param_types[0]);
-        args_size += push_args_typechecked(com, node.token, node.args, func.param_types | std::views::drop(1));
-        push_value(code(com), op::call_static, func.id, args_size);
+        const auto args_size = push_call_args(com, node.token, node.args, func.id, 1, temps_size);
+        push_value(code(com), op::call_static, func.id, com.types.size_of(func.param_types[0]) + args_size);
+        release_temps(com, temps_size, *func.return_type);
         return { *func.return_type };
     }
 
@@ -1501,6 +1742,60 @@ auto push_expr(compiler& com, compile_type ct, const node_ternary_expr& node) ->
     return { type };
 }
 
+// Atomic intrinsics operate on 64 bit integers through a pointer. Returns the integer type.
+auto atomic_value_type(const token& tok, const type_name& ptr_type, bool writes) -> type_name
+{
+    tok.assert(ptr_type.is<type_ptr>(), "atomic operations require a pointer, got '{}'", ptr_type);
+    const auto inner = ptr_type.remove_ptr();
+    const auto value_type = inner.remove_const();
+    tok.assert(value_type == type_name{type_i64{}} || value_type == type_name{type_u64{}},
+               "atomic operations require a pointer to an i64 or u64, got '{}'", ptr_type);
+    tok.assert(!writes || !inner.is_const, "cannot write through a pointer to const");
+    return value_type;
+}
+
+// The builtin struct returned by the @parse intrinsics, holding the parsed value and the number
+// of characters used. It is created the first time it is needed.
+auto parse_result_type(compiler& com, const type_name& value_type) -> type_name
+{
+    const auto type = type_struct{ .name="parse_result", .module="builtin", .templates={value_type} };
+    if (!com.types.contains(type)) {
+        com.types.add_type(type);
+        com.types.add_field(type, type_field{"value", value_type});
+        com.types.add_field(type, type_field{"size", type_u64{}});
+    }
+    return type;
+}
+
+// Returns the op for an f64 maths intrinsic along with the number of arguments it takes
+auto math_intrinsic(std::string_view name) -> std::optional<std::pair<op, std::size_t>>
+{
+    if (name == "sqrt") return {{op::f64_sqrt, 1}};
+    if (name == "floor") return {{op::f64_floor, 1}};
+    if (name == "ceil") return {{op::f64_ceil, 1}};
+    if (name == "round") return {{op::f64_round, 1}};
+    if (name == "abs") return {{op::f64_abs, 1}};
+    if (name == "exp") return {{op::f64_exp, 1}};
+    if (name == "log") return {{op::f64_log, 1}};
+    if (name == "sin") return {{op::f64_sin, 1}};
+    if (name == "cos") return {{op::f64_cos, 1}};
+    if (name == "pow") return {{op::f64_pow, 2}};
+    if (name == "min") return {{op::f64_min, 2}};
+    if (name == "max") return {{op::f64_max, 2}};
+    if (name == "fma") return {{op::f64_fma, 3}};
+    return std::nullopt;
+}
+
+// Pushes one of the span arguments of a span intrinsic and returns its element type
+auto push_numeric_span(compiler& com, const node_intrinsic_expr& node, std::size_t index, bool writes) -> type_name
+{
+    const auto type = push_expr(com, compile_type::val, *node.args[index]).type;
+    node.token.assert(type.is<type_span>(), "@{} requires spans, got '{}'", node.name, type);
+    const auto element_type = type.remove_span();
+    node.token.assert(!writes || !element_type.is_const, "@{} cannot write to a span of const", node.name);
+    return element_type.remove_const();
+}
+
 auto push_expr(compiler& com, compile_type ct, const node_intrinsic_expr& node) -> expr_result
 {
     node.token.assert(ct == compile_type::val, "cannot take the address of a @intrinsic function call");
@@ -1558,7 +1853,7 @@ auto push_expr(compiler& com, compile_type ct, const node_intrinsic_expr& node)
     if (node.name == "type_name_of") {
         node.token.assert_eq(node.args.size(), 1, "@type_name_of only accepts one argument");
         const auto str = std::format("{}", type_of_expr(com, *node.args[0]).type);
-        std::print("@type_name_of == {}\n", str);
+        if (com.options.verbose) std::print("@type_name_of == {}\n", str);
         push_value(code(com), op::push_string_literal, insert_into_rom(com, str), str.size());
         return { string_literal_type() };
     }
@@ -1598,7 +1893,7 @@ auto push_expr(compiler& com, compile_type ct, const node_intrinsic_expr& node)
         const auto type = type_of_expr(com, *node.args[0]).type;
         node.token.assert(type.is<type_function>(), "can only convert functions to function pointers");
         const auto& info = type.as<type_function>();
-        push_value(code(com), op::push_function_ptr, info.id);
+        push_value(code(com), op::push_function_ptr, function_ptr_id(com, info.id));
         return { type_function_ptr{.param_types=info.param_types, .return_type=info.return_type} };
     }
     if (node.name == "is_fundamental") {
@@ -1632,19 +1927,247 @@ auto push_expr(compiler& com, compile_type ct, const node_intrinsic_expr& node)
         push_value(code(com), op::push_bool, is_span);
         return { type_bool{}, {is_span} };
     }
-    if (node.name == "read_file") {
+    if (node.name == "args") {
+        node.token.assert_eq(node.args.size(), 0, "@args takes no arguments");
+        push_value(code(com), op::program_args);
+        return { type_name{type_char{}}.add_const().add_span().add_const().add_span() };
+    }
+    if (node.name == "read_file" || node.name == "map_file") {
         const auto char_span = type_name{type_char{}}.add_const().add_span();
         const auto arena_ptr = type_name{type_arena{}}.add_ptr();
 
-        node.token.assert_eq(node.args.size(), 2, "@read_file requires a filename and arena");
+        node.token.assert_eq(node.args.size(), 2, "@{} requires a filename and arena", node.name);
         const auto file_type = push_expr(com, compile_type::val, *node.args[0]).type;
         node.token.assert_eq(file_type, char_span, "incorrect type for file path");
         const auto arena_type = push_expr(com, compile_type::val, *node.args[1]).type;
         node.token.assert_eq(arena_type, arena_ptr, "incorrect type for arena");
         push_value(code(com), op::load, sizeof(std::byte*)); // load the arena
-        push_value(code(com), op::read_file);
+        push_value(code(com), node.name == "read_file" ? op::read_file : op::map_file);
         return { char_span };
     }
+    if (node.name == "open_reader") {
+        const auto char_span = type_name{type_char{}}.add_const().add_span();
+        const auto arena_ptr = type_name{type_arena{}}.add_ptr();
+
+        node.token.assert_eq(node.args.size(), 2, "@open_reader requires a filename and arena");
+        const auto file_type = push_expr(com, compile_type::val, *node.args[0]).type;
+        node.token.assert_eq(file_type, char_span, "incorrect type for file path");
+        const auto arena_type = push_expr(com, compile_type::val, *node.args[1]).type;
+        node.token.assert_eq(arena_type, arena_ptr, "incorrect type for arena");
+        push_value(code(com), op::load, sizeof(std::byte*)); // load the arena
+        push_value(code(com), op::open_reader);
+        return { type_u64{} };
+    }
+    if (node.name == "reader_valid" || node.name == "read_line") {
+        node.token.assert_eq(node.args.size(), 1, "@{} requires a reader", node.name);
+        push_copy_typechecked(com, *node.args[0], type_u64{}, node.token);
+        if (node.name == "reader_valid") {
+            push_value(code(com), op::reader_valid);
+            return { type_bool{} };
+        }
+        push_value(code(com), op::read_line);
+        return { type_name{type_char{}}.add_const().add_span() };
+    }
+    if (node.name == "open_write") {
+        const auto char_span = type_name{type_char{}}.add_const().add_span();
+        const auto arena_ptr = type_name{type_arena{}}.add_ptr();
+
+        node.token.assert_eq(node.args.size(), 2, "@open_write requires a filename and arena");
+        const auto file_type = push_expr(com, compile_type::val, *node.args[0]).type;
+        node.token.assert_eq(file_type, char_span, "incorrect type for file path");
+        const auto arena_type = push_expr(com, compile_type::val, *node.args[1]).type;
+        node.token.assert_eq(arena_type, arena_ptr, "incorrect type for arena");
+        push_value(code(com), op::load, sizeof(std::byte*)); // load the arena
+        push_value(code(com), op::open_write);
+        return { type_u64{} };
+    }
+    if (node.name == "write" || node.name == "write_i64" || node.name == "write_f64") {
+        const auto value_type = node.name == "write"     ? type_name{type_char{}}.add_const().add_span()
+                              : node.name == "write_i64" ? type_name{type_i64{}}
+                                                         : type_name{type_f64{}};
+        node.token.assert_eq(node.args.size(), 2, "@{} requires a file and a value", node.name);
+        push_copy_typechecked(com, *node.args[0], type_u64{}, node.token);
+        push_copy_typechecked(com, *node.args[1], value_type, node.token);
+        push_value(code(com), node.name == "write"     ? op::write
+                            : node.name == "write_i64" ? op::write_i64
+                                                       : op::write_f64);
+        return { type_null{} };
+    }
+    if (node.name == "close") {
+        node.token.assert_eq(node.args.size(), 1, "@close requires a file");
+        push_copy_typechecked(com, *node.args[0], type_u64{}, node.token);
+        push_value(code(com), op::close);
+        return { type_null{} };
+    }
+    if (node.name == "find" || node.name == "find_char") {
+        const auto char_span = type_name{type_char{}}.add_const().add_span();
+        const auto needle_type = node.name == "find" ? char_span : type_name{type_char{}};
+        node.token.assert_eq(node.args.size(), 3, "@{} requires a string, what to find and a start index", node.name);
+        push_copy_typechecked(com, *node.args[0], char_span, node.token);
+        push_copy_typechecked(com, *node.args[1], needle_type, node.token);
+        push_copy_typechecked(com, *node.args[2], type_u64{}, node.token);
+        push_value(code(com), node.name == "find" ? op::find : op::find_char);
+        return { type_u64{} };
+    }
+    if (node.name == "parse_i64" || node.name == "parse_u64" || node.name == "parse_f64") {
+        node.token.assert_eq(node.args.size(), 1, "@{} requires a string to parse", node.name);
+        const auto char_span = type_name{type_char{}}.add_const().add_span();
+        push_copy_typechecked(com, *node.args[0], char_span, node.token);
+        if (node.name == "parse_i64") {
+            push_value(code(com), op::parse_i64);
+            return { parse_result_type(com, type_i64{}) };
+        }
+        if (node.name == "parse_u64") {
+            push_value(code(com), op::parse_u64);
+            return { parse_result_type(com, type_u64{}) };
+        }
+        push_value(code(com), op::parse_f64);
+        return { parse_result_type(com, type_f64{}) };
+    }
+    if (node.name == "sort" || node.name == "sort_by") {
+        const auto num_args = node.name == "sort" ? 1 : 3;
+        node.token.assert_eq(node.args.size(), num_args, "@{} requires {} arguments", node.name, num_args);
+        const auto span_type = type_of_expr(com, *node.args[0]).type;
+        node.token.assert(span_type.is<type_span>(), "@{} requires a span, got '{}'", node.name, span_type);
+        const auto element_type = span_type.remove_span();
+        node.token.assert(!element_type.is_const, "cannot sort a span of const, got '{}'", span_type);
+        push_expr(com, compile_type::val, *node.args[0]);
+        if (node.name == "sort") {
+            const auto key = sort_key_of(node.token, element_type);
+            push_value(code(com), op::sort, static_cast<std::uint64_t>(key));
+            return { type_null{} };
+        }
+        push_copy_typechecked(com, *node.args[1], type_u64{}, node.token);
+        const auto key_type = get_type_value(node.token, type_of_expr(com, *node.args[2]));
+        const auto key = sort_key_of(node.token, key_type);
+        node.token.assert(com.types.size_of(key_type) <= com.types.size_of(element_type),
+                          "cannot sort elements of type '{}' by a '{}'", element_type, key_type);
+        push_value(code(com), op::sort_by, static_cast<std::uint64_t>(key), com.types.size_of(element_type));
+        return { type_null{} };
+    }
+    if (node.name == "hash_bytes") {
+        node.token.assert(node.args.size() == 1 || node.args.size() == 2, "@hash_bytes requires a span, or a pointer and a size");
+        const auto type = push_expr(com, compile_type::val, *node.args[0]).type;
+        if (node.args.size() == 1) {
+            node.token.assert(type.is<type_span>(), "@hash_bytes requires a span, got '{}'", type);
+            push_value(code(com), op::hash_bytes, com.types.size_of(type.remove_span()));
+        } else {
+            node.token.assert(type.is<type_ptr>(), "@hash_bytes requires a pointer, got '{}'", type);
+            push_copy_typechecked(com, *node.args[1], type_u64{}, node.token);
+            push_value(code(com), op::hash_bytes, std::uint64_t{1});
+        }
+        return { type_u64{} };
+    }
+    if (node.name == "sum" || ((node.name == "min" || node.name == "max") && node.args.size() == 1)) {
+        node.token.assert_eq(node.args.size(), 1, "@{} requires a span", node.name);
+        const auto element_type = push_numeric_span(com, node, 0, false);
+        const auto type = numeric_type_of(node.token, element_type);
+        const auto op_code = node.name == "sum" ? op::span_sum : (node.name == "min" ? op::span_min : op::span_max);
+        push_value(code(com), op_code, static_cast<std::uint64_t>(type));
+        return { element_type };
+    }
+    if (node.name == "count_eq") {
+        node.token.assert_eq(node.args.size(), 2, "@count_eq requires a span and a value");
+        const auto element_type = push_numeric_span(com, node, 0, false);
+        const auto type = numeric_type_of(node.token, element_type);
+        push_copy_typechecked(com, *node.args[1], element_type, node.token);
+        push_value(code(com), op::span_count_eq, static_cast<std::uint64_t>(type));
+        return { type_u64{} };
+    }
+    if (node.name == "dot") {
+        node.token.assert_eq(node.args.size(), 2, "@dot requires two spans");
+        const auto element_type = push_numeric_span(com, node, 0, false);
+        const auto type = numeric_type_of(node.token, element_type);
+        node.token.assert_eq(push_numeric_span(com, node, 1, false), element_type, "@dot requires spans of the same type");
+        push_value(code(com), op::span_dot, static_cast<std::uint64_t>(type));
+        return { element_type };
+    }
+    if (node.name == "add" || node.name == "mul") {
+        node.token.assert_eq(node.args.size(), 3, "@{} requires a destination span and two spans", node.name);
+        const auto element_type = push_numeric_span(com, node, 0, true);
+        const auto type = numeric_type_of(node.token, element_type);
+        node.token.assert_eq(push_numeric_span(com, node, 1, false), element_type, "@{} requires spans of the same type", node.name);
+        node.token.assert_eq(push_numeric_span(com, node, 2, false), element_type, "@{} requires spans of the same type", node.name);
+        push_value(code(com), node.name == "add" ? op::span_add : op::span_mul, static_cast<std::uint64_t>(type));
+        return { type_null{} };
+    }
+    if (node.name == "scale") {
+        node.token.assert_eq(node.args.size(), 3, "@scale requires a destination span, a span and a factor");
+        const auto element_type = push_numeric_span(com, node, 0, true);
+        const auto type = numeric_type_of(node.token, element_type);
+        node.token.assert_eq(push_numeric_span(com, node, 1, false), element_type, "@scale requires spans of the same type");
+        push_copy_typechecked(com, *node.args[2], element_type, node.token);
+        push_value(code(com), op::span_scale, static_cast<std::uint64_t>(type));
+        return { type_null{} };
+    }
+    if (const auto math = math_intrinsic(node.name)) {
+        const auto [op_code, num_args] = *math;
+        node.token.assert_eq(node.args.size(), num_args, "@{} requires {} f64 arguments", node.name, num_args);
+        for (const auto& arg : node.args) {
+            push_copy_typechecked(com, *arg, type_f64{}, node.token);
+        }
+        push_value(code(com), op_code);
+        return { type_f64{} };
+    }
+    if (node.name == "spawn") {
+        node.token.assert_eq(node.args.size(), 2, "@spawn requires a function and an argument");
+        auto fn_type = type_of_expr(com, *node.args[0]).type;
+        if (const auto info = fn_type.get_if<type_function>()) {
+            fn_type = info->to_pointer();
+        }
+        node.token.assert(fn_type.is<type_function_ptr>(), "@spawn requires a function, got '{}'", fn_type);
+        const auto& info = fn_type.as<type_function_ptr>();
+        node.token.assert_eq(info.param_types.size(), 1, "@spawn requires a function taking one argument");
+        node.token.assert_eq(*info.return_type, type_name{type_null{}}, "@spawn requires a function returning null");
+        push_copy_typechecked(com, *node.args[1], info.param_types[0], node.token);
+        push_copy_typechecked(com, *node.args[0], fn_type, node.token);
+        push_value(code(com), op::spawn, com.types.size_of(info.param_types[0]));
+        return { type_u64{} };
+    }
+    if (node.name == "join") {
+        node.token.assert_eq(node.args.size(), 1, "@join requires a thread handle");
+        push_copy_typechecked(com, *node.args[0], type_u64{}, node.token);
+        push_value(code(com), op::join);
+        return { type_null{} };
+    }
+    if (node.name == "parallel_for") {
+        node.token.assert_eq(node.args.size(), 2, "@parallel_for requires a span and a function");
+        const auto span_type = type_of_expr(com, *node.args[0]).type;
+        node.token.assert(span_type.is<type_span>(), "@parallel_for requires a span, got '{}'", span_type);
+        auto fn_type = type_of_expr(com, *node.args[1]).type;
+        if (const auto info = fn_type.get_if<type_function>()) {
+            fn_type = info->to_pointer();
+        }
+        node.token.assert(fn_type.is<type_function_ptr>(), "@parallel_for requires a function, got '{}'", fn_type);
+        const auto& info = fn_type.as<type_function_ptr>();
+        const auto element_type = span_type.remove_span();
+        node.token.assert(info.param_types.size() == 1 && const_convertable_to(node.token, element_type.add_ptr(), info.param_types[0]),
+                          "@parallel_for requires a function taking a pointer to an element of '{}'", span_type);
+        node.token.assert_eq(*info.return_type, type_name{type_null{}}, "@parallel_for requires a function returning null");
+        push_expr(com, compile_type::val, *node.args[0]);
+        push_copy_typechecked(com, *node.args[1], fn_type, node.token);
+        push_value(code(com), op::parallel_for, com.types.size_of(element_type));
+        return { type_null{} };
+    }
+    if (node.name == "atomic_load") {
+        node.token.assert_eq(node.args.size(), 1, "@atomic_load requires a pointer");
+        const auto ptr_type = push_expr(com, compile_type::val, *node.args[0]).type;
+        const auto value_type = atomic_value_type(node.token, ptr_type, false);
+        push_value(code(com), op::atomic_load);
+        return { value_type };
+    }
+    if (node.name == "atomic_store" || node.name == "atomic_fetch_add") {
+        node.token.assert_eq(node.args.size(), 2, "@{} requires a pointer and a value", node.name);
+        const auto ptr_type = push_expr(com, compile_type::val, *node.args[0]).type;
+        const auto value_type = atomic_value_type(node.token, ptr_type, true);
+        push_copy_typechecked(com, *node.args[1], value_type, node.token);
+        if (node.name == "atomic_store") {
+            push_value(code(com), op::atomic_store);
+            return { type_null{} };
+        }
+        push_value(code(com), op::atomic_fetch_add);
+        return { value_type };
+    }
     node.token.error("no intrisic function named @{} exists", node.name);
 }
 
@@ -1920,6 +2443,7 @@ auto push_stmt(compiler& com, const node_declaration_stmt& node) -> void
                                    : expr_type;
     type.is_const = node.add_const;
     node.token.assert(!type.is<type_arena>(), "cannot create copies of arenas");
+    variables(com).align_next(code(com), slot_alignment(type));
     push_copy_typechecked(com, *node.expr, type, node.token);
     push_name_pack(com, node.token, node.names, type, expr_value);
 }
@@ -1984,20 +2508,34 @@ void push_stmt(compiler& com, const node_print_stmt& node)
         node.token.error("Not enough args to fill all placeholders");
     }
 
-    if (!parts.front().empty()) {
-        push_value(code(com), op::push_string_literal);
-        push_value(code(com), insert_into_rom(com, parts.front()), parts.front().size());
-        push_value(code(com), op::print_char_span);
-    }
-    for (std::size_t i = 0; i != node.args.size(); ++i) {
-        push_print_fundamental(com, *node.args.at(i), node.token);
+    // The args are pushed first so that the whole statement is printed by a single op. An arg
+    // that calls a function may print too, so everything before it is printed first to keep
+    // the output in order.
+    auto format = std::string{};
+    auto args_size = std::size_t{0};
+    const auto push_literal = [&](std::string_view text) {
+        if (text.empty()) return;
+        const auto size = static_cast<std::uint64_t>(text.size());
+        format.push_back(static_cast<char>(print_part::literal));
+        format.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        format.append(text);
+    };
+    const auto flush = [&] {
+        if (format.empty()) return;
+        push_value(code(com), op::print_fmt, insert_into_rom(com, format), format.size(), args_size);
+        format.clear();
+        args_size = 0;
+    };
 
-        if (!parts[i+1].empty()) {
-            push_value(code(com), op::push_string_literal);
-            push_value(code(com), insert_into_rom(com, parts[i+1]), parts[i+1].size());
-            push_value(code(com), op::print_char_span);
-        }
+    push_literal(parts.front());
+    for (std::size_t i = 0; i != node.args.size(); ++i) {
+        if (may_call(*node.args.at(i))) flush();
+        const auto type = push_expr(com, compile_type::val, *node.args.at(i)).type;
+        format.push_back(static_cast<char>(print_part_of(node.token, type)));
+        args_size += com.types.size_of(type);
+        push_literal(parts[i+1]);
     }
+    flush();
 }
 
 auto push_expr(compiler& com, compile_type ct, const node_expr& expr) -> expr_result
@@ -2005,16 +2543,36 @@ auto push_expr(compiler& com, compile_type ct, const node_expr& expr) -> expr_re
     return std::visit([&](const auto& node) { return push_expr(com, ct, node); }, expr);
 }
 
+// Records that the code emitted from this point on comes from the given token's line
+auto record_line(compiler& com, const token& tok) -> void
+{
+    const auto [it, inserted] = com.module_ids.try_emplace(curr_module(com), com.module_ids.size());
+    const auto offset = static_cast<std::uint32_t>(code(com).size());
+    add_line(current(com).lines, {offset, it->second, static_cast<std::uint32_t>(tok.line)});
+}
+
 auto push_stmt(compiler& com, const node_stmt& root) -> void
 {
-    std::visit([&](const auto& node) { push_stmt(com, node); }, root);
+    std::visit([&](const auto& node) {
+        record_line(com, node.token);
+        push_stmt(com, node);
+        record_line(com, node.token); // any trailing code, eg- loop jumps, belong to this statement
+    }, root);
 }
 
 }
 
-auto compile(const anzu_module& ast) -> bytecode_program
+auto compile(
+    const anzu_module& ast,
+    module_map imports,
+    const compile_options& options,
+    compile_stats* stats
+)
+    -> bytecode_program
 {
     auto com = compiler{};
+    com.options = options;
+    com.parsed_modules = std::move(imports);
     const auto fname = function_name{"__main__", no_struct, "$main"};
     com.functions.emplace_back(fname, 0, variable_manager{false});
 
@@ -2029,11 +2587,21 @@ auto compile(const anzu_module& ast) -> bytecode_program
     com.current_function.pop_back();
 
     push_value(com.functions[0].code, op::end_program);
+    if (com.options.inline_functions) {
+        inline_small_functions(com, 0, 0);
+    }
 
     auto program = bytecode_program{};
     program.rom = com.rom;
     for (const auto& function : com.functions) {
-        program.functions.push_back(bytecode_function{function.name.to_string(), function.id, function.code});
+        program.functions.push_back(bytecode_function{function.name.to_string(), function.id, function.code, function.lines});
+    }
+    program.modules.resize(com.module_ids.size());
+    for (const auto& [module, index] : com.module_ids) {
+        program.modules[index] = module.string();
+    }
+    if (stats) {
+        *stats = std::move(com.stats);
     }
     return program;
 }
@@ -18,25 +18,54 @@ namespace anzu {
 
 struct function
 {
-    function_name          name;
-    std::size_t            id;
-    variable_manager       variables;
-    template_map           templates;
-    std::vector<type_name> params;
-    type_name              return_type;
-    std::vector<std::byte> code;
+    function_name           name;
+    std::size_t             id;
+    variable_manager        variables;
+    template_map            templates;
+    std::vector<type_name>  params;
+    std::vector<bool>       by_ref_params; // params passed as a pointer to the argument
+    type_name               return_type;
+    std::vector<std::byte>  code;
+    std::vector<line_entry> lines = {};
+    const node_stmt*        body  = nullptr; // null for generated functions
+};
+
+// Statistics gathered while compiling, reported by the --stats flag
+struct compile_stats
+{
+    std::size_t function_instantiations = 0;
+    std::size_t struct_instantiations   = 0;
+
+    // Wall time to compile each imported module, including the modules that it imports
+    std::vector<std::pair<std::filesystem::path, double>> module_seconds = {};
+};
+
+struct compile_options
+{
+    bool inline_functions = true;
+    bool verbose = false; // prints each module as it is parsed and compiled
 };
 
 struct compiler
 {
+    compile_options options;
+    compile_stats   stats;
+
     std::vector<function> functions;
     std::string           rom;
 
     type_manager types;
 
     std::unordered_set<std::filesystem::path> modules;
+    module_map                                parsed_modules;
+
+    // Indices of the modules referred to by line tables
+    std::unordered_map<std::filesystem::path, std::uint32_t> module_ids;
 
     std::unordered_map<function_name, std::size_t> functions_by_name;
+
+    // Functions with by-ref params taking their params by value, for use as function pointers
+    std::unordered_map<std::size_t, std::size_t> by_value_thunks;
     
     std::unordered_map<type_function_template, node_function_stmt> function_templates;
     std::unordered_map<type_struct_template,   node_struct_stmt>   struct_templates;
@@ -48,6 +77,12 @@ struct compiler
     std::vector<const std::unordered_set<std::string>*> current_placeholders;
 };
 
-auto compile(const anzu_module& ast) -> bytecode_program;
+auto compile(
+    const anzu_module& ast,
+    module_map imports = {},
+    const compile_options& options = {},
+    compile_stats* stats = nullptr
+)
+    -> bytecode_program;
 
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdexcept>
+
+namespace anzu {
+
+// Thrown for any error found while lexing, parsing, compiling or running a program. The
+// message says where the error is, and is what the anzu executable prints before exiting.
+struct error : public std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+}
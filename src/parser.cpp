@@ -3,10 +3,13 @@
 #include "lexer.hpp"
 #include "utility/common.hpp"
 
+#include <exception>
 #include <string_view>
 #include <vector>
 #include <memory>
 #include <charconv>
+#include <future>
+#include <unordered_set>
 
 namespace anzu {
 namespace {
@@ -658,6 +661,7 @@ auto parse_continue_stmt(tokenstream& tokens) -> node_stmt_ptr
 auto parse_statement(tokenstream& tokens) -> node_stmt_ptr
 {
     const auto drain_semicolons = scope_exit([&] {
+        if (std::uncaught_exceptions() > 0) return; // the tokens are abandoned on an error
         while (tokens.consume_maybe(token_type::semicolon));
     });
 
@@ -699,6 +703,7 @@ auto parse_statement(tokenstream& tokens) -> node_stmt_ptr
 auto parse_top_level_statement(tokenstream& tokens) -> node_stmt_ptr
 {
     const auto drain_semicolons = scope_exit([&] {
+        if (std::uncaught_exceptions() > 0) return; // the tokens are abandoned on an error
         while (tokens.consume_maybe(token_type::semicolon));
     });
     if (!tokens.valid()) return nullptr;
@@ -715,8 +720,14 @@ auto parse_top_level_statement(tokenstream& tokens) -> node_stmt_ptr
 
 auto parse(const std::filesystem::path& file) -> anzu_module
 {
+    return parse_source(std::move(*anzu::read_file(file)));
+}
+
+auto parse_source(std::string source_code) -> anzu_module
+{
+    const auto timer = stopwatch{};
     auto new_module = anzu_module{};
-    new_module.source_code = anzu::read_file(file);
+    new_module.source_code = std::make_unique<std::string>(std::move(source_code));
     new_module.root = std::make_shared<node_stmt>();
     auto& seq = new_module.root->emplace<node_sequence_stmt>();
 
@@ -725,7 +736,62 @@ auto parse(const std::filesystem::path& file) -> anzu_module
         while (stream.consume_maybe(token_type::semicolon));
         seq.sequence.push_back(parse_top_level_statement(stream));
     }
+    new_module.parse_seconds = timer.seconds();
     return new_module;
 }
 
+auto scan_imports(std::string_view source_code) -> std::vector<std::filesystem::path>
+{
+    auto imports = std::vector<std::filesystem::path>{};
+    auto stream = tokenstream{source_code};
+    while (stream.valid()) {
+        const auto token = stream.consume();
+        if (token.type != token_type::at) continue;
+        if (stream.curr().type != token_type::identifier || stream.curr().text != "import") continue;
+        if (stream.next().type != token_type::left_paren) continue;
+        stream.consume(); // import
+        stream.consume(); // (
+        if (stream.curr().type == token_type::string) {
+            imports.emplace_back(stream.curr().text);
+        }
+    }
+    return imports;
+}
+
+auto parse_imports(const anzu_module& root) -> module_map
+{
+    struct parsed_module
+    {
+        anzu_module                        module;
+        std::vector<std::filesystem::path> imports;
+    };
+
+    auto modules = module_map{};
+    auto seen = std::unordered_set<std::filesystem::path>{};
+    auto frontier = scan_imports(*root.source_code);
+
+    while (!frontier.empty()) {
+        auto pending = std::vector<std::pair<std::filesystem::path, std::future<parsed_module>>>{};
+        for (const auto& filepath : frontier) {
+            if (!seen.emplace(filepath).second) continue;
+            pending.emplace_back(filepath, std::async(std::launch::async, [filepath] {
+                auto mod = parse(std::filesystem::absolute(filepath));
+                auto imports = scan_imports(*mod.source_code);
+                return parsed_module{std::move(mod), std::move(imports)};
+            }));
+        }
+
+        // Circular imports are fine here since each module is only parsed once, detecting
+        // them is left to the compiler which knows the order the modules are loaded in
+        frontier.clear();
+        for (auto& [filepath, future] : pending) {
+            auto [mod, imports] = future.get();
+            frontier.insert(frontier.end(), imports.begin(), imports.end());
+            modules.emplace(filepath, std::move(mod));
+        }
+    }
+
+    return modules;
 }
+
+}
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <set>
 #include <string>
 #include <filesystem>
+#include <unordered_map>
 
 namespace anzu {
 
@@ -13,8 +14,21 @@ struct anzu_module
 {
     std::unique_ptr<std::string> source_code; // TODO: make this a std::unique_ptr<char[]>
     node_stmt_ptr root;
+    double parse_seconds = 0.0; // wall time spent lexing and parsing the module
 };
 
+// Imported modules keyed by the path as written in the @import statement
+using module_map = std::unordered_map<std::filesystem::path, anzu_module>;
+
 auto parse(const std::filesystem::path& file) -> anzu_module;
+auto parse_source(std::string source_code) -> anzu_module;
+
+// Scans the token stream for @import("...") expressions and returns the paths in the order
+// that they appear. This does not parse the code, so it is cheap enough to use as a pre-pass.
+auto scan_imports(std::string_view source_code) -> std::vector<std::filesystem::path>;
+
+// Walks the import graph of the given module and parses every module that it transitively
+// depends on. Each layer of the graph is parsed in parallel.
+auto parse_imports(const anzu_module& root) -> module_map;
 
 }
\ No newline at end of file
@@ -0,0 +1,396 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <map>
+#include <print>
+#include <ranges>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/time.h>
+#define ANZU_HAS_SIGPROF
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define ANZU_HAS_PERF_EVENTS
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ANZU_HAS_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ANZU_HAS_RDTSC
+#endif
+
+namespace anzu {
+namespace {
+
+constexpr auto num_rows = std::size_t{20};
+
+auto percent(std::uint64_t part, std::uint64_t total) -> double
+{
+    return total == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(total);
+}
+
+// Returns the given line of a file with surrounding whitespace removed, or an empty string
+// if it cannot be read
+auto source_line(const std::string& file, std::size_t line) -> std::string
+{
+    auto stream = std::ifstream{file};
+    auto text = std::string{};
+    for (std::size_t i = 0; i != line; ++i) {
+        if (!std::getline(stream, text)) return {};
+    }
+    const auto begin = text.find_first_not_of(" \t");
+    const auto end = text.find_last_not_of(" \t\r");
+    return begin == std::string::npos ? std::string{} : text.substr(begin, end - begin + 1);
+}
+
+#ifdef ANZU_HAS_PERF_EVENTS
+// Opens a counter for the given hardware event on this thread, as part of the group led by
+// the given file descriptor (or as the leader if it is -1)
+auto open_counter(std::uint64_t config, int group) -> int
+{
+    auto attr = perf_event_attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(perf_event_attr);
+    attr.config = config;
+    attr.disabled = group == -1 ? 1 : 0; // the whole group is enabled via the leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+#endif
+
+constexpr auto counter_names = std::array<std::string_view, counter_profiler::num_counters>{
+    "cycles", "instructions", "branch-misses", "cache-misses"
+};
+
+}
+
+auto read_tick_counter() -> std::uint64_t
+{
+#ifdef ANZU_HAS_RDTSC
+    return __rdtsc();
+#else
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+profiler::profiler(std::size_t num_functions)
+    : d_functions(num_functions)
+{
+    d_nodes.push_back(stack_node{.function = 0, .parent = 0}); // the root, not a real function
+    d_calls.reserve(1000);
+}
+
+auto profiler::on_call(bytecode_context&, std::size_t id) -> void
+{
+    const auto parent = d_calls.empty() ? std::size_t{0} : d_calls.back().node;
+    auto [it, inserted] = d_nodes[parent].children.try_emplace(id, d_nodes.size());
+    const auto node = it->second;
+    if (inserted) {
+        d_nodes.push_back(stack_node{.function = id, .parent = parent});
+    }
+
+    auto& stats = d_functions[id];
+    ++stats.calls;
+    ++stats.active;
+    d_calls.push_back(active_call{.function = id, .node = node, .start = read_tick_counter()});
+}
+
+auto profiler::on_return(bytecode_context&) -> void
+{
+    const auto call = d_calls.back();
+    d_calls.pop_back();
+    const auto elapsed = read_tick_counter() - call.start;
+    const auto exclusive = elapsed - std::min(elapsed, call.children);
+
+    auto& stats = d_functions[call.function];
+    --stats.active;
+    if (stats.active == 0) { // only count the outermost frame of recursive calls
+        stats.inclusive += elapsed;
+    }
+    stats.exclusive += exclusive;
+    d_nodes[call.node].exclusive += exclusive;
+    if (!d_calls.empty()) {
+        d_calls.back().children += elapsed;
+    }
+}
+
+auto profiler::report(const bytecode_program& prog, const std::filesystem::path& stacks_file) const -> void
+{
+    const auto total_ticks = d_functions.empty() ? std::uint64_t{0} : d_functions[0].inclusive;
+    auto total_ops = std::uint64_t{0};
+    for (const auto count : d_op_counts) total_ops += count;
+
+    std::print("\nPROFILE (ticks={}, ops={})\n", total_ticks, total_ops);
+    std::print("==================================\n");
+    std::print("{:>10} {:>8} {:>8}  function\n", "calls", "incl%", "excl%");
+    auto functions = std::views::iota(std::size_t{0}, d_functions.size())
+                   | std::views::filter([&](std::size_t id) { return d_functions[id].calls > 0; })
+                   | std::ranges::to<std::vector>();
+    std::ranges::sort(functions, std::greater{}, [&](std::size_t id) { return d_functions[id].exclusive; });
+    for (const auto id : functions) {
+        const auto& stats = d_functions[id];
+        std::print("{:>10} {:>7.2f}% {:>7.2f}%  {}\n",
+                   stats.calls,
+                   percent(stats.inclusive, total_ticks),
+                   percent(stats.exclusive, total_ticks),
+                   prog.functions[id].name);
+    }
+
+    std::print("\n{:>12} {:>8}  op code\n", "count", "%");
+    auto ops = std::views::iota(std::size_t{0}, d_op_counts.size())
+             | std::views::filter([&](std::size_t op_code) { return d_op_counts[op_code] > 0; })
+             | std::ranges::to<std::vector>();
+    std::ranges::sort(ops, std::greater{}, [&](std::size_t op_code) { return d_op_counts[op_code]; });
+    for (const auto op_code : ops | std::views::take(num_rows)) {
+        std::print("{:>12} {:>7.2f}%  {}\n",
+                   d_op_counts[op_code],
+                   percent(d_op_counts[op_code], total_ops),
+                   op_name(static_cast<op>(op_code)));
+    }
+
+    std::print("\n{:>12} {:>8}  op code pair\n", "count", "%");
+    auto pairs = std::views::iota(std::size_t{0}, d_pair_counts.size())
+               | std::views::filter([&](std::size_t pair) { return d_pair_counts[pair] > 0; })
+               | std::ranges::to<std::vector>();
+    std::ranges::sort(pairs, std::greater{}, [&](std::size_t pair) { return d_pair_counts[pair]; });
+    for (const auto pair : pairs | std::views::take(num_rows)) {
+        std::print("{:>12} {:>7.2f}%  {} -> {}\n",
+                   d_pair_counts[pair],
+                   percent(d_pair_counts[pair], total_ops),
+                   op_name(static_cast<op>(pair / 256)),
+                   op_name(static_cast<op>(pair % 256)));
+    }
+
+    // Write each unique call stack along with the exclusive time spent in it
+    auto file = std::ofstream{stacks_file};
+    if (!file) {
+        std::print("\nfailed to write call stacks to '{}'\n", stacks_file.string());
+        return;
+    }
+    for (std::size_t node = 1; node != d_nodes.size(); ++node) {
+        if (d_nodes[node].exclusive == 0) continue;
+        auto names = std::vector<std::string_view>{};
+        for (auto curr = node; curr != 0; curr = d_nodes[curr].parent) {
+            names.push_back(prog.functions[d_nodes[curr].function].name);
+        }
+        auto line = std::string{};
+        for (const auto name : names | std::views::reverse) {
+            if (!line.empty()) line += ';';
+            line += name;
+        }
+        file << std::format("{} {}\n", line, d_nodes[node].exclusive);
+    }
+    std::print("\nwrote call stacks to '{}'\n", stacks_file.string());
+}
+
+sampler::sampler(std::size_t num_functions, std::chrono::microseconds interval)
+{
+    d_calls.reserve(1000);
+    d_samples.reserve(num_functions * 16);
+    d_sample_requested = false;
+
+#ifdef ANZU_HAS_SIGPROF
+    struct sigaction action = {};
+    action.sa_handler = [](int) { d_sample_requested.store(true, std::memory_order_relaxed); };
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, nullptr);
+
+    auto timer = itimerval{};
+    timer.it_interval.tv_sec = interval.count() / 1'000'000;
+    timer.it_interval.tv_usec = interval.count() % 1'000'000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+#else
+    d_timer = std::jthread{[interval](std::stop_token token) {
+        while (!token.stop_requested()) {
+            std::this_thread::sleep_for(interval);
+            d_sample_requested.store(true, std::memory_order_relaxed);
+        }
+    }};
+#endif
+}
+
+sampler::~sampler()
+{
+#ifdef ANZU_HAS_SIGPROF
+    auto timer = itimerval{};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    signal(SIGPROF, SIG_DFL);
+#endif
+}
+
+auto sampler::record(const call_frame& frame) -> void
+{
+    const auto offset = static_cast<std::uint64_t>(frame.ip - frame.code);
+    ++d_samples[(static_cast<std::uint64_t>(d_calls.back()) << 32) | offset];
+    ++d_total;
+}
+
+auto sampler::report(const bytecode_program& prog) const -> void
+{
+    // Inlined code has the line table entries of the function it came from, so samples
+    // are grouped by source line rather than by function
+    auto lines = std::map<std::pair<std::uint32_t, std::uint32_t>, std::uint64_t>{};
+    auto unknown = std::uint64_t{0};
+    for (const auto& [key, count] : d_samples) {
+        const auto& function = prog.functions[key >> 32];
+        if (const auto entry = find_line(function.lines, key & 0xffff'ffff)) {
+            lines[{entry->module, entry->line}] += count;
+        } else {
+            unknown += count;
+        }
+    }
+
+    using line_samples = std::pair<std::pair<std::uint32_t, std::uint32_t>, std::uint64_t>;
+    auto hottest = std::vector<line_samples>(lines.begin(), lines.end());
+    std::ranges::sort(hottest, std::greater{}, &line_samples::second);
+
+    std::print("\nSAMPLES (total={}, unknown={})\n", d_total, unknown);
+    std::print("==================================\n");
+    std::print("{:>10} {:>8}  line\n", "samples", "%");
+    for (const auto& [location, count] : hottest | std::views::take(num_rows)) {
+        const auto& [module, line] = location;
+        std::print("{:>10} {:>7.2f}%  {}:{}\n", count, percent(count, d_total), prog.modules[module], line);
+        if (const auto text = source_line(prog.modules[module], line); !text.empty()) {
+            std::print("{:>21}{}\n", "", text);
+        }
+    }
+}
+
+counter_profiler::counter_profiler(std::size_t num_functions)
+    : d_functions(num_functions)
+{
+    d_calls.reserve(1000);
+#ifdef ANZU_HAS_PERF_EVENTS
+    static constexpr auto configs = std::array<std::uint64_t, num_counters>{
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    d_fds[0] = open_counter(configs[0], -1);
+    if (d_fds[0] == -1) {
+        d_error = std::format("perf_event_open failed: {}", std::strerror(errno));
+        return;
+    }
+    for (std::size_t i = 1; i != num_counters; ++i) {
+        d_fds[i] = open_counter(configs[i], d_fds[0]); // leave as -1 if not supported
+    }
+    ioctl(d_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(d_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    d_error = "hardware performance counters are only supported on Linux";
+#endif
+}
+
+counter_profiler::~counter_profiler()
+{
+#ifdef ANZU_HAS_PERF_EVENTS
+    for (const auto fd : d_fds) {
+        if (fd != -1) close(fd);
+    }
+#endif
+}
+
+auto counter_profiler::read_counters() -> counts
+{
+    auto ret = counts{};
+#ifdef ANZU_HAS_PERF_EVENTS
+    if (d_fds[0] == -1) return ret;
+
+    // With PERF_FORMAT_GROUP, the read gives the number of counters followed by the value
+    // of each counter that was successfully opened, in the order they were opened
+    auto buffer = std::array<std::uint64_t, 1 + num_counters>{};
+    if (read(d_fds[0], buffer.data(), sizeof(buffer)) <= 0) return d_last;
+    auto value = std::size_t{1};
+    for (std::size_t i = 0; i != num_counters; ++i) {
+        if (d_fds[i] != -1) ret[i] = buffer[value++];
+    }
+#endif
+    return ret;
+}
+
+// Adds the counts since the last transition to the function that was running
+auto counter_profiler::attribute() -> void
+{
+    const auto now = read_counters();
+    if (!d_calls.empty()) {
+        auto& totals = d_functions[d_calls.back()].totals;
+        for (std::size_t i = 0; i != num_counters; ++i) {
+            totals[i] += now[i] - d_last[i];
+        }
+    }
+    d_last = now;
+}
+
+auto counter_profiler::on_call(bytecode_context&, std::size_t id) -> void
+{
+    attribute();
+    ++d_functions[id].calls;
+    d_calls.push_back(id);
+}
+
+auto counter_profiler::on_return(bytecode_context&) -> void
+{
+    attribute();
+    d_calls.pop_back();
+}
+
+auto counter_profiler::report(const bytecode_program& prog) const -> void
+{
+    if (!d_error.empty()) {
+        std::print("\nperformance counters unavailable, {}\n", d_error);
+        return;
+    }
+
+    auto total = counts{};
+    for (const auto& stats : d_functions) {
+        for (std::size_t i = 0; i != num_counters; ++i) total[i] += stats.totals[i];
+    }
+    const auto column = [&](const counts& values, std::size_t index) {
+        return d_fds[index] == -1 ? std::string{"n/a"} : std::to_string(values[index]);
+    };
+
+    std::print("\nPERFORMANCE COUNTERS (excluding callees, inlined functions count towards their caller)\n");
+    std::print("==================================\n");
+    std::print("{:>10} {:>14} {:>14} {:>6} {:>14} {:>14}  function\n",
+               "calls", counter_names[0], counter_names[1], "ipc", counter_names[2], counter_names[3]);
+    auto functions = std::views::iota(std::size_t{0}, d_functions.size())
+                   | std::views::filter([&](std::size_t id) { return d_functions[id].calls > 0; })
+                   | std::ranges::to<std::vector>();
+    std::ranges::sort(functions, std::greater{}, [&](std::size_t id) { return d_functions[id].totals[0]; });
+    for (const auto id : functions) {
+        const auto& stats = d_functions[id];
+        const auto ipc = stats.totals[0] == 0 ? 0.0 : static_cast<double>(stats.totals[1]) / static_cast<double>(stats.totals[0]);
+        std::print("{:>10} {:>14} {:>14} {:>6.2f} {:>14} {:>14}  {}\n",
+                   stats.calls,
+                   column(stats.totals, 0),
+                   column(stats.totals, 1),
+                   ipc,
+                   column(stats.totals, 2),
+                   column(stats.totals, 3),
+                   prog.functions[id].name);
+    }
+    std::print("{:>10} {:>14} {:>14} {:>6} {:>14} {:>14}  total\n",
+               "", column(total, 0), column(total, 1), "", column(total, 2), column(total, 3));
+}
+
+}
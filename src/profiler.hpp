@@ -0,0 +1,157 @@
+#pragma once
+#include "bytecode.hpp"
+#include "runtime.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace anzu {
+
+// A cheap, monotonic tick counter. This is the CPU timestamp counter where available and
+// nanoseconds from a steady clock elsewhere.
+auto read_tick_counter() -> std::uint64_t;
+
+// A tracer for execute_program that counts op codes and pairs of consecutive op codes, and
+// records the calls to and the time spent in each function. Time spent in a function that
+// was inlined is attributed to its caller.
+class profiler
+{
+    struct function_stats
+    {
+        std::uint64_t calls     = 0;
+        std::uint64_t inclusive = 0;
+        std::uint64_t exclusive = 0;
+        std::uint64_t active    = 0; // number of frames for this function on the call stack
+    };
+
+    // A node in the tree of unique call stacks
+    struct stack_node
+    {
+        std::size_t   function;
+        std::size_t   parent;
+        std::uint64_t exclusive = 0;
+        std::unordered_map<std::size_t, std::size_t> children = {};
+    };
+
+    struct active_call
+    {
+        std::size_t   function;
+        std::size_t   node;
+        std::uint64_t start;
+        std::uint64_t children = 0; // ticks spent in callees
+    };
+
+    std::array<std::uint64_t, 256> d_op_counts   = {};
+    std::vector<std::uint64_t>     d_pair_counts = std::vector<std::uint64_t>(256 * 256);
+    std::uint8_t                   d_prev_op     = 0;
+
+    std::vector<function_stats> d_functions;
+    std::vector<stack_node>     d_nodes;
+    std::vector<active_call>    d_calls;
+
+public:
+    profiler(std::size_t num_functions);
+
+    auto on_op(bytecode_context&, const call_frame& frame) -> void
+    {
+        const auto op_code = static_cast<std::uint8_t>(*frame.ip);
+        ++d_op_counts[op_code];
+        ++d_pair_counts[d_prev_op * 256 + op_code];
+        d_prev_op = op_code;
+    }
+
+    auto on_call(bytecode_context& ctx, std::size_t id) -> void;
+    auto on_return(bytecode_context& ctx) -> void;
+
+    // Prints the report and writes the collapsed stacks to the given file
+    auto report(const bytecode_program& prog, const std::filesystem::path& stacks_file) const -> void;
+};
+
+// A tracer for execute_program that periodically records the instruction about to be
+// executed and then maps those back to lines of source code. On POSIX systems the samples
+// are requested by a SIGPROF timer, which measures CPU time used, and elsewhere by a
+// background thread that wakes up at the same interval.
+class sampler
+{
+    // Set by the timer and cleared by the next call to on_op
+    static inline std::atomic<bool> d_sample_requested = false;
+
+    std::vector<std::size_t> d_calls; // ids of the functions on the call stack
+    std::unordered_map<std::uint64_t, std::uint64_t> d_samples; // (function, offset) -> count
+    std::uint64_t d_total = 0;
+    std::jthread  d_timer;
+
+    auto record(const call_frame& frame) -> void;
+
+public:
+    sampler(std::size_t num_functions, std::chrono::microseconds interval = std::chrono::microseconds{1000});
+    ~sampler();
+
+    sampler(const sampler&) = delete;
+    sampler& operator=(const sampler&) = delete;
+
+    auto on_op(bytecode_context&, const call_frame& frame) -> void
+    {
+        if (d_sample_requested.load(std::memory_order_relaxed)) [[unlikely]] {
+            d_sample_requested.store(false, std::memory_order_relaxed);
+            record(frame);
+        }
+    }
+
+    auto on_call(bytecode_context&, std::size_t id) -> void { d_calls.push_back(id); }
+    auto on_return(bytecode_context&) -> void { d_calls.pop_back(); }
+
+    // Prints the source lines with the most samples
+    auto report(const bytecode_program& prog) const -> void;
+};
+
+// A tracer for execute_program that reads the hardware performance counters whenever a
+// function is called or returns and attributes the difference to the function that was
+// running, excluding its callees. Only available on Linux; elsewhere, or if the counters
+// cannot be opened, the program runs as normal and the report says why.
+class counter_profiler
+{
+public:
+    static constexpr auto num_counters = std::size_t{4};
+    using counts = std::array<std::uint64_t, num_counters>;
+
+private:
+    struct function_stats
+    {
+        std::uint64_t calls  = 0;
+        counts        totals = {};
+    };
+
+    std::array<int, num_counters> d_fds = {-1, -1, -1, -1}; // -1 if the counter is unavailable
+    std::string                   d_error;
+
+    std::vector<function_stats> d_functions;
+    std::vector<std::size_t>    d_calls; // ids of the functions on the call stack
+    counts                      d_last = {};
+
+    auto read_counters() -> counts;
+    auto attribute() -> void;
+
+public:
+    counter_profiler(std::size_t num_functions);
+    ~counter_profiler();
+
+    counter_profiler(const counter_profiler&) = delete;
+    counter_profiler& operator=(const counter_profiler&) = delete;
+
+    auto on_op(bytecode_context&, const call_frame&) -> void {}
+    auto on_call(bytecode_context& ctx, std::size_t id) -> void;
+    auto on_return(bytecode_context& ctx) -> void;
+
+    // Prints the counts for each function
+    auto report(const bytecode_program& prog) const -> void;
+};
+
+}
@@ -1,19 +1,48 @@
 #include "runtime.hpp"
 #include "bytecode.hpp"
 #include "object.hpp"
+#include "profiler.hpp"
+#include "span_kernels.hpp"
+#include "utility/common.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <string_view>
+#include <type_traits>
 #include <utility>
+#include <vector>
 #include <format>
 
 namespace anzu {
 namespace {
 
+// Returns the source location of the instruction currently being executed in the top frame
+auto current_location(const bytecode_context& ctx) -> std::string
+{
+    const auto& frame = ctx.frames.back();
+    for (const auto& function : ctx.functions) {
+        if (function.code.data() != frame.code) continue;
+        const auto offset = static_cast<std::size_t>(frame.ip - frame.code) - 1;
+        if (const auto entry = find_line(function.lines, offset)) {
+            return std::format("{}:{}", ctx.modules[entry->module], entry->line);
+        }
+    }
+    return "unknown location";
+}
+
 template <typename ...Args>
-[[noreturn]] auto runtime_error(std::format_string<Args...> message, Args&&... args)
+[[noreturn]] auto runtime_error(const bytecode_context& ctx, std::format_string<Args...> message, Args&&... args)
 {
     const auto msg = std::format(message, std::forward<Args>(args)...);
-    panic("runtime assertion failed! {}", msg);
+    program_output().flush();
+    panic("runtime assertion failed! {} ({})", msg, current_location(ctx));
 }
 
 template <typename Type, template <typename> typename Op>
@@ -33,11 +62,70 @@ auto binary_op(bytecode_context& ctx) -> void
     ctx.stack.push(op(lhs, rhs));
 }
 
-template <typename Type>
-auto print_value(bytecode_context& ctx) -> void
+// Pops as many f64 arguments as the function takes and pushes its result
+template <typename Func>
+auto math_op(bytecode_context& ctx, Func&& func) -> void
 {
-    const auto obj = ctx.stack.pop<Type>();
-    std::print("{}", obj);
+    if constexpr (std::is_invocable_v<Func, double>) {
+        const auto x = ctx.stack.pop<double>();
+        ctx.stack.push(func(x));
+    } else if constexpr (std::is_invocable_v<Func, double, double>) {
+        const auto y = ctx.stack.pop<double>();
+        const auto x = ctx.stack.pop<double>();
+        ctx.stack.push(func(x, y));
+    } else {
+        const auto z = ctx.stack.pop<double>();
+        const auto y = ctx.stack.pop<double>();
+        const auto x = ctx.stack.pop<double>();
+        ctx.stack.push(func(x, y, z));
+    }
+}
+
+template <typename T>
+auto read_arg(const std::byte*& args) -> T
+{
+    T ret;
+    std::memcpy(&ret, args, sizeof(T));
+    args += sizeof(T);
+    return ret;
+}
+
+// Prints the args laid out on the stack using a format built by the compiler for a print
+// statement. Everything is written in one go so prints from different threads do not mix.
+auto print_formatted(std::string_view format, const std::byte* args) -> void
+{
+    auto out = output_buffer::writer{program_output()};
+    for (std::size_t i = 0; i != format.size(); ++i) {
+        switch (static_cast<print_part>(format[i])) {
+            case print_part::literal: {
+                auto size = std::uint64_t{0};
+                std::memcpy(&size, &format[i + 1], sizeof(size));
+                out.write(format.substr(i + 1 + sizeof(size), size));
+                i += sizeof(size) + size;
+            } break;
+            case print_part::null_value: {
+                read_arg<std::byte>(args);
+                out.write("null");
+            } break;
+            case print_part::bool_value: {
+                out.write(read_arg<bool>(args) ? "true" : "false");
+            } break;
+            case print_part::char_value: {
+                const auto c = read_arg<char>(args);
+                out.write({&c, 1});
+            } break;
+            case print_part::i32_value: { out.write_number(read_arg<std::int32_t>(args)); } break;
+            case print_part::i64_value: { out.write_number(read_arg<std::int64_t>(args)); } break;
+            case print_part::u64_value: { out.write_number(read_arg<std::uint64_t>(args)); } break;
+            case print_part::f64_value: { out.write_number(read_arg<double>(args)); } break;
+            case print_part::ptr_value: { out.write_address(read_arg<std::uint64_t>(args)); } break;
+            case print_part::char_span_value: {
+                const auto ptr = read_arg<const char*>(args);
+                const auto size = read_arg<std::uint64_t>(args);
+                out.write({ptr, size});
+            } break;
+        }
+    }
 }
 
 template <typename T>
@@ -50,17 +138,491 @@ auto read_advance(bytecode_context& ctx) -> T
     return ret;
 }
 
-template <bool Debug>
-auto execute_program(bytecode_context& ctx) -> void
+// Tracers observe the execution of a program. Each one provides on_op, which is called
+// before each op code is executed, and on_call and on_return, which are called after a
+// new frame is pushed and before a frame is popped respectively.
+struct no_tracer
+{
+    auto on_op(bytecode_context&, const call_frame&) -> void {}
+    auto on_call(bytecode_context&, std::size_t) -> void {}
+    auto on_return(bytecode_context&) -> void {}
+};
+
+struct debug_tracer
+{
+    auto on_op(bytecode_context& ctx, const call_frame& frame) -> void
+    {
+        program_output().flush();
+        print_op(ctx.rom, frame.code, frame.ip);
+    }
+    auto on_call(bytecode_context&, std::size_t) -> void {}
+    auto on_return(bytecode_context&) -> void {}
+};
+
+// Tracks the peak memory usage of the program. Arenas only ever grow until they are deleted,
+// so their peak is the amount in use when deleted, or at the end for any still alive.
+struct stats_tracer
+{
+    runtime_stats stats = {};
+
+    auto on_op(bytecode_context& ctx, const call_frame& frame) -> void
+    {
+        stats.peak_stack_bytes = std::max(stats.peak_stack_bytes, ctx.stack.size());
+        if (static_cast<op>(*frame.ip) == op::arena_delete) {
+            auto arena = static_cast<memory_arena*>(nullptr);
+            std::memcpy(&arena, &ctx.stack.at(ctx.stack.size() - sizeof(arena)), sizeof(arena));
+            stats.arena_peak_bytes = std::max(stats.arena_peak_bytes, arena->next);
+        }
+    }
+    auto on_call(bytecode_context&, std::size_t) -> void {}
+    auto on_return(bytecode_context& ctx) -> void
+    {
+        if (ctx.frames.size() > 1) return; // only interested in the end of the program
+        stats.arenas_created = ctx.arenas.size();
+        for (const auto& arena : ctx.arenas) {
+            stats.arena_peak_bytes = std::max(stats.arena_peak_bytes, arena->next);
+        }
+    }
+};
+
+template <typename Tracer>
+auto execute_program(bytecode_context& ctx, Tracer& tracer) -> void;
+
+// Placed below the frame of a function called from the runtime, so that execution stops
+// once the function returns
+constexpr auto call_exit = std::array{static_cast<std::byte>(op::end_program)};
+
+// Calls the given function with the args on top of the stack and runs it to completion,
+// leaving the return value on the stack. The call is not traced since this is used for
+// calls on other threads, and tracers are not thread safe.
+auto run_function(bytecode_context& ctx, std::size_t function_id, std::size_t args_size) -> void
+{
+    const auto base_ptr = ctx.stack.size() - args_size;
+    ctx.frames.emplace_back(call_frame{
+        .code = call_exit.data(),
+        .ip = call_exit.data(),
+        .base_ptr = base_ptr
+    });
+    ctx.frames.emplace_back(call_frame{
+        .code = ctx.functions[function_id].code.data(),
+        .ip = ctx.functions[function_id].code.data(),
+        .base_ptr = base_ptr
+    });
+    auto tracer = no_tracer{};
+    execute_program(ctx, tracer);
+    ctx.frames.pop_back();
+}
+
+// A context for running part of the program on another thread, sharing everything that is
+// not specific to a single thread with the given context
+auto thread_context(const bytecode_context& ctx) -> bytecode_context
+{
+    auto new_ctx = bytecode_context{ctx.functions, ctx.rom, ctx.modules, ctx.threads, ctx.args};
+    new_ctx.frames.reserve(1000);
+    return new_ctx;
+}
+
+// Pops the args from the stack and starts a thread that calls the given function with them
+// on a stack of its own
+auto spawn_thread(bytecode_context& ctx, std::size_t function_id, std::size_t args_size) -> std::uint64_t
+{
+    auto args = std::vector<std::byte>(args_size);
+    ctx.stack.pop_and_save(args.data(), args_size);
+
+    // The spawning thread may finish first, so the new context is made up front
+    const auto lock = std::lock_guard{ctx.threads.mutex};
+    ctx.threads.threads.emplace_back([thread_ctx = thread_context(ctx), function_id, args = std::move(args)]() mutable {
+        try {
+            thread_ctx.stack.push(args.data(), args.size());
+            run_function(thread_ctx, function_id, args.size());
+        } catch (...) {
+            const auto lock = std::lock_guard{thread_ctx.threads.mutex};
+            if (!thread_ctx.threads.error) thread_ctx.threads.error = std::current_exception();
+        }
+    });
+    return ctx.threads.threads.size() - 1;
+}
+
+auto rethrow_thread_error(thread_registry& registry) -> void
+{
+    const auto lock = std::lock_guard{registry.mutex};
+    if (registry.error) std::rethrow_exception(std::exchange(registry.error, nullptr));
+}
+
+auto join_thread(bytecode_context& ctx, std::uint64_t handle) -> void
+{
+    auto thread = std::jthread{};
+    {
+        const auto lock = std::lock_guard{ctx.threads.mutex};
+        if (handle < ctx.threads.threads.size()) {
+            thread = std::move(ctx.threads.threads[handle]);
+        }
+    }
+    if (!thread.joinable()) {
+        runtime_error(ctx, "invalid thread handle {}, it may have already been joined", handle);
+    }
+    thread.join();
+    rethrow_thread_error(ctx.threads);
+}
+
+// Joins every thread from the given index on that is still running, including any that they
+// spawn in the meantime. Errors from the threads are left for rethrow_thread_error.
+auto join_all_threads(thread_registry& registry, std::size_t first = 0) -> void
+{
+    for (std::size_t index = first; ; ++index) {
+        auto thread = std::jthread{};
+        {
+            const auto lock = std::lock_guard{registry.mutex};
+            if (index == registry.threads.size()) break;
+            thread = std::move(registry.threads[index]);
+        }
+        if (thread.joinable()) thread.join();
+    }
+}
+
+// A contiguous range of indices owned by a worker in a parallel for. The owner takes chunks
+// from the front, and workers that run out steal half of what is left from the back.
+struct work_range
+{
+    std::mutex  mutex;
+    std::size_t begin = 0;
+    std::size_t end   = 0;
+};
+
+auto take_front(work_range& range, std::size_t chunk_size) -> std::pair<std::size_t, std::size_t>
+{
+    const auto lock = std::lock_guard{range.mutex};
+    const auto begin = range.begin;
+    range.begin = std::min(range.begin + chunk_size, range.end);
+    return {begin, range.begin};
+}
+
+auto steal_back(work_range& range) -> std::pair<std::size_t, std::size_t>
+{
+    const auto lock = std::lock_guard{range.mutex};
+    const auto end = range.end;
+    range.end -= (range.end - range.begin + 1) / 2;
+    return {range.end, end};
+}
+
+// Set on threads running the body of a parallel for, since nested loops run serially
+thread_local auto in_parallel_for = false;
+
+// Calls the given function with a pointer to each element of the span, split across a thread
+// for each core. Each worker has its own context and starts with an equal share of the
+// indices, and the chunks that they take are small enough that stealing can balance out
+// elements that take longer than others. Returns once every element has been processed.
+auto parallel_for(
+    bytecode_context& ctx,
+    std::byte* data,
+    std::size_t count,
+    std::size_t element_size,
+    std::size_t function_id
+)
+    -> void
+{
+    const auto call = [&](bytecode_context& worker_ctx, std::size_t index) {
+        const auto size = worker_ctx.stack.size();
+        worker_ctx.stack.push(data + index * element_size);
+        run_function(worker_ctx, function_id, sizeof(std::byte*));
+        worker_ctx.stack.resize(size);
+    };
+
+    const auto num_workers = std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), count);
+    if (in_parallel_for || num_workers < 2) {
+        for (std::size_t index = 0; index != count; ++index) {
+            call(ctx, index);
+        }
+        return;
+    }
+
+    const auto chunk_size = std::max<std::size_t>(count / (num_workers * 16), 1);
+    auto ranges = std::vector<work_range>(num_workers);
+    for (std::size_t i = 0; i != num_workers; ++i) {
+        ranges[i].begin = count * i / num_workers;
+        ranges[i].end = count * (i + 1) / num_workers;
+    }
+
+    // Returns the next chunk of indices for the given worker, which is empty once there is
+    // no work left to steal
+    const auto next_chunk = [&](std::size_t id) {
+        while (true) {
+            const auto chunk = take_front(ranges[id], chunk_size);
+            if (chunk.first != chunk.second) return chunk;
+
+            auto stolen = std::pair<std::size_t, std::size_t>{};
+            for (std::size_t i = 1; i != num_workers && stolen.first == stolen.second; ++i) {
+                stolen = steal_back(ranges[(id + i) % num_workers]);
+            }
+            if (stolen.first == stolen.second) return stolen;
+
+            const auto lock = std::lock_guard{ranges[id].mutex};
+            std::tie(ranges[id].begin, ranges[id].end) = stolen;
+        }
+    };
+
+    // The first error thrown by a worker, rethrown once all of the workers have stopped
+    auto error_mutex = std::mutex{};
+    auto error = std::exception_ptr{};
+
+    // The contexts outlive the workers so that threads spawned by a worker that failed can
+    // be joined before the memory they may point into is freed
+    auto worker_ctxs = std::vector<bytecode_context>{};
+    worker_ctxs.reserve(num_workers);
+    for (std::size_t id = 0; id != num_workers; ++id) {
+        worker_ctxs.push_back(thread_context(ctx));
+    }
+    const auto first_thread = [&] {
+        const auto lock = std::lock_guard{ctx.threads.mutex};
+        return ctx.threads.threads.size();
+    }();
+
+    const auto work = [&](std::size_t id) {
+        in_parallel_for = true;
+        try {
+            auto& worker_ctx = worker_ctxs[id];
+            for (auto [begin, end] = next_chunk(id); begin != end; std::tie(begin, end) = next_chunk(id)) {
+                for (auto index = begin; index != end; ++index) {
+                    call(worker_ctx, index);
+                }
+            }
+        } catch (...) {
+            const auto lock = std::lock_guard{error_mutex};
+            if (!error) error = std::current_exception();
+        }
+        in_parallel_for = false;
+    };
+
+    auto workers = std::vector<std::jthread>{};
+    for (std::size_t id = 1; id != num_workers; ++id) {
+        workers.emplace_back(work, id);
+    }
+    work(0); // the calling thread is a worker too
+    workers.clear();
+    if (error) {
+        join_all_threads(ctx.threads, first_thread);
+        std::rethrow_exception(error);
+    }
+}
+
+// Returns the index of the first occurrence of the needle in the haystack at or after the
+// given start, or the size of the haystack if there is none
+auto find_substring(std::string_view haystack, std::string_view needle, std::size_t start) -> std::size_t
+{
+    if (start > haystack.size()) return haystack.size();
+#if defined(__GLIBC__) || defined(__APPLE__)
+    // memmem is vectorised, unlike the search in std::string_view::find
+    const auto found = memmem(haystack.data() + start, haystack.size() - start, needle.data(), needle.size());
+    return found ? static_cast<std::size_t>(static_cast<const char*>(found) - haystack.data()) : haystack.size();
+#else
+    const auto found = haystack.find(needle, start);
+    return found == std::string_view::npos ? haystack.size() : found;
+#endif
+}
+
+auto find_char(std::string_view haystack, char c, std::size_t start) -> std::size_t
+{
+    if (start >= haystack.size()) return haystack.size();
+    const auto found = std::memchr(haystack.data() + start, c, haystack.size() - start);
+    return found ? static_cast<std::size_t>(static_cast<const char*>(found) - haystack.data()) : haystack.size();
+}
+
+// Parses a number from the start of a span on the stack and pushes it followed by the number
+// of characters used, which is zero if the span does not start with a number that fits in T
+template <typename T>
+auto parse_number(bytecode_context& ctx) -> void
+{
+    const auto size = ctx.stack.pop<std::uint64_t>();
+    const auto data = ctx.stack.pop<const char*>();
+    auto value = T{};
+    const auto [end, ec] = std::from_chars(data, data + size, value);
+    const auto parsed = ec == std::errc{};
+    ctx.stack.push(parsed ? value : T{});
+    ctx.stack.push(parsed ? static_cast<std::uint64_t>(end - data) : std::uint64_t{0});
+}
+
+// Floats are compared by their total order so that NaNs cannot break the sort
+template <typename T>
+auto key_less(T lhs, T rhs) -> bool
+{
+    if constexpr (std::is_floating_point_v<T>) {
+        return std::strong_order(lhs, rhs) < 0;
+    } else {
+        return lhs < rhs;
+    }
+}
+
+// The span may not be aligned for T, so the values are copied out, sorted and copied back
+template <typename T>
+auto sort_values(std::byte* data, std::size_t count) -> void
+{
+    auto values = std::make_unique_for_overwrite<T[]>(count);
+    std::memcpy(values.get(), data, count * sizeof(T));
+    std::sort(values.get(), values.get() + count, key_less<T>);
+    std::memcpy(data, values.get(), count * sizeof(T));
+}
+
+// Sorts the elements by the key at the given offset within them, keeping equal elements in
+// order. The keys are sorted along with their indices so that each element is copied once.
+template <typename T>
+auto sort_values_by(std::byte* data, std::size_t count, std::size_t element_size, std::size_t offset) -> void
+{
+    auto keys = std::vector<std::pair<T, std::size_t>>(count);
+    for (std::size_t i = 0; i != count; ++i) {
+        std::memcpy(&keys[i].first, data + i * element_size + offset, sizeof(T));
+        keys[i].second = i;
+    }
+    std::ranges::stable_sort(keys, key_less<T>, &std::pair<T, std::size_t>::first);
+    auto sorted = std::vector<std::byte>(count * element_size);
+    for (std::size_t i = 0; i != count; ++i) {
+        std::memcpy(sorted.data() + i * element_size, data + keys[i].second * element_size, element_size);
+    }
+    std::memcpy(data, sorted.data(), sorted.size());
+}
+
+auto key_size(sort_key key) -> std::size_t
+{
+    switch (key) {
+        case sort_key::bool_key: return sizeof(bool);
+        case sort_key::char_key: return sizeof(char);
+        case sort_key::i32_key: return sizeof(std::int32_t);
+        case sort_key::i64_key: return sizeof(std::int64_t);
+        case sort_key::u64_key: return sizeof(std::uint64_t);
+        case sort_key::f64_key: return sizeof(double);
+    }
+    return 0;
+}
+
+auto sort_span(sort_key key, std::byte* data, std::size_t count) -> void
+{
+    switch (key) {
+        case sort_key::bool_key: sort_values<bool>(data, count); break;
+        case sort_key::char_key: sort_values<char>(data, count); break;
+        case sort_key::i32_key: sort_values<std::int32_t>(data, count); break;
+        case sort_key::i64_key: sort_values<std::int64_t>(data, count); break;
+        case sort_key::u64_key: sort_values<std::uint64_t>(data, count); break;
+        case sort_key::f64_key: sort_values<double>(data, count); break;
+    }
+}
+
+auto sort_span_by(sort_key key, std::byte* data, std::size_t count, std::size_t element_size, std::size_t offset) -> void
+{
+    switch (key) {
+        case sort_key::bool_key: sort_values_by<bool>(data, count, element_size, offset); break;
+        case sort_key::char_key: sort_values_by<char>(data, count, element_size, offset); break;
+        case sort_key::i32_key: sort_values_by<std::int32_t>(data, count, element_size, offset); break;
+        case sort_key::i64_key: sort_values_by<std::int64_t>(data, count, element_size, offset); break;
+        case sort_key::u64_key: sort_values_by<std::uint64_t>(data, count, element_size, offset); break;
+        case sort_key::f64_key: sort_values_by<double>(data, count, element_size, offset); break;
+    }
+}
+
+// A fast non-cryptographic hash that reads eight bytes at a time and finishes with the
+// splitmix64 mixer so that every input bit affects the low bits, which hash maps index with
+auto hash_bytes(const std::byte* data, std::size_t size) -> std::uint64_t
+{
+    constexpr auto multiplier = std::uint64_t{0x9e3779b97f4a7c15};
+    auto hash = size * multiplier;
+    auto word = std::uint64_t{0};
+    for (; size >= sizeof(word); data += sizeof(word), size -= sizeof(word)) {
+        std::memcpy(&word, data, sizeof(word));
+        hash = std::rotl(hash ^ (word * multiplier), 27) * multiplier;
+    }
+    word = 0;
+    std::memcpy(&word, data, size);
+    hash ^= word * multiplier;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+}
+
+// Calls the function with a value of the element type that a span_ op works on, so that it can
+// use the kernels for that type
+template <typename Func>
+auto with_numeric_type(numeric_type type, Func&& func) -> void
+{
+    switch (type) {
+        case numeric_type::i32_type: func(std::int32_t{}); break;
+        case numeric_type::i64_type: func(std::int64_t{}); break;
+        case numeric_type::u64_type: func(std::uint64_t{}); break;
+        case numeric_type::f64_type: func(double{}); break;
+    }
+}
+
+auto check_same_length(bytecode_context& ctx, std::string_view name, std::uint64_t lhs, std::uint64_t rhs) -> void
+{
+    if (lhs != rhs) {
+        runtime_error(ctx, "@{} requires spans of the same length, got {} and {}", name, lhs, rhs);
+    }
+}
+
+// Returns the reader for a handle from @open_reader, checking that it is still open
+auto reader_for(const bytecode_context& ctx, std::uint64_t handle) -> line_reader&
+{
+    if (handle >= ctx.readers.size() || !ctx.readers[handle]) {
+        runtime_error(ctx, "invalid reader handle {}, its arena may have been deleted", handle);
+    }
+    return *ctx.readers[handle];
+}
+
+// Returns the writer for a handle from @open_write, checking that it has not been deleted
+auto writer_handle(const bytecode_context& ctx, std::uint64_t handle) -> file_writer&
+{
+    if (handle >= ctx.writers.size() || !ctx.writers[handle]) {
+        runtime_error(ctx, "invalid writer handle {}, its arena may have been deleted", handle);
+    }
+    return *ctx.writers[handle];
+}
+
+// Returns the writer for a handle from @open_write, checking that it can still be written to
+auto writer_for(const bytecode_context& ctx, std::uint64_t handle) -> file_writer&
+{
+    auto& writer = writer_handle(ctx, handle);
+    if (!writer.is_open()) {
+        runtime_error(ctx, "cannot write to a closed file");
+    }
+    if (!writer.ok()) {
+        runtime_error(ctx, "failed to write to file");
+    }
+    return writer;
+}
+
+// Allocations are aligned like malloc so that any scalar, including the targets of atomic ops,
+// can be stored at the start of one
+constexpr auto arena_alignment = std::size_t{8};
+
+auto arena_allocate(const bytecode_context& ctx, memory_arena& arena, std::size_t size) -> std::byte*
+{
+    const auto start = (arena.next + arena_alignment - 1) / arena_alignment * arena_alignment;
+    if (start + size > arena.data.size()) {
+        runtime_error(ctx, "arena overflow");
+    }
+    arena.next = start + size;
+    return &arena.data[start];
+}
+
+// The 64 bit integer at the given address, which must be suitably aligned
+auto atomic_at(const bytecode_context& ctx, std::byte* ptr) -> std::atomic_ref<std::uint64_t>
+{
+    using atomic_type = std::atomic_ref<std::uint64_t>;
+    if (reinterpret_cast<std::uintptr_t>(ptr) % atomic_type::required_alignment != 0) {
+        runtime_error(ctx, "atomic operations require an address aligned to {} bytes", atomic_type::required_alignment);
+    }
+    return atomic_type{*reinterpret_cast<std::uint64_t*>(ptr)};
+}
+
+template <typename Tracer>
+auto execute_program(bytecode_context& ctx, Tracer& tracer) -> void
 {
     while (true) {
         auto& frame = ctx.frames.back();
-        if constexpr (Debug) {
-            print_op(ctx.rom, frame.code, frame.ip);
-        }
+        tracer.on_op(ctx, frame);
         const auto op_code = read_advance<op>(ctx);
         switch (op_code) {
-            case op::end_program: return;
+            case op::end_program: {
+                tracer.on_return(ctx);
+                return;
+            }
             case op::push_char:
             case op::push_bool: {
                 ctx.stack.push(read_advance<std::uint8_t>(ctx));
@@ -144,6 +706,7 @@ auto execute_program(bytecode_context& ctx) -> void
             } break;
             case op::push: {
                 const auto size = read_advance<std::uint64_t>(ctx);
+                std::memset(&ctx.stack.at(ctx.stack.size()), 0, size); // default constructed objects are zeroed
                 ctx.stack.resize(ctx.stack.size() + size);
             } break;
             case op::pop: {
@@ -157,7 +720,7 @@ auto execute_program(bytecode_context& ctx) -> void
                 const auto dst_count = ctx.stack.pop<std::uint64_t>(); 
                 const auto dst_data = ctx.stack.pop<std::byte*>();
                 if (dst_count < src_count) {
-                    runtime_error("dst span too small to hold src span");
+                    runtime_error(ctx, "dst span too small to hold src span");
                 }
                 std::memcpy(dst_data, src_data, src_count * type_size);
                 ctx.stack.push(std::byte{0}); // returns null;
@@ -172,7 +735,7 @@ auto execute_program(bytecode_context& ctx) -> void
             case op::arena_new: {
                 memory_arena* arena = nullptr;
                 if (ctx.arena_free_list.empty()) {
-                    ctx.arenas.push_back(std::make_unique<memory_arena>());
+                    ctx.arenas.push_back(std::make_unique_for_overwrite<memory_arena>());
                     arena = ctx.arenas.back().get();
                     arena->index = ctx.arenas.size() - 1;
                 } else {
@@ -185,16 +748,25 @@ auto execute_program(bytecode_context& ctx) -> void
             } break;
             case op::arena_delete: {
                 const auto arena = ctx.stack.pop<memory_arena*>();
+                arena->mapped_files.clear();
+                for (const auto handle : arena->readers) {
+                    ctx.readers[handle].reset();
+                }
+                arena->readers.clear();
+                auto closed = true;
+                for (const auto handle : arena->writers) {
+                    closed = std::exchange(ctx.writers[handle], nullptr)->close() && closed;
+                }
+                arena->writers.clear();
                 ctx.arena_free_list.push_back(arena->index);
+                if (!closed) {
+                    runtime_error(ctx, "failed to write to file when closing it with its arena");
+                }
             } break;
             case op::arena_alloc: {
                 auto arena = ctx.stack.pop<memory_arena*>();
                 const auto size = read_advance<std::uint64_t>(ctx);
-                if (arena->next + size > arena->data.size()) {
-                    runtime_error("arena overflow");
-                }
-                const auto data = &arena->data[arena->next];
-                arena->next += size;
+                const auto data = arena_allocate(ctx, *arena, size);
                 ctx.stack.pop_and_save(data, size);
                 ctx.stack.push(data);
             } break;
@@ -202,16 +774,11 @@ auto execute_program(bytecode_context& ctx) -> void
                 const auto type_size = read_advance<std::uint64_t>(ctx);
                 auto arena = ctx.stack.pop<memory_arena*>();
                 const auto count = ctx.stack.pop<std::uint64_t>();
-                const auto size = type_size * count;
-                if (arena->next + size > arena->data.size()) {
-                    runtime_error("arena overflow");
-                }
-                const auto data = &arena->data[arena->next];
+                const auto data = arena_allocate(ctx, *arena, type_size * count);
                 for (size_t i = 0; i != count; ++i) {
                     ctx.stack.save(data + i * type_size, type_size);
                 }
                 ctx.stack.pop_n(type_size);
-                arena->next += size;
                 ctx.stack.push(data); // push the span (ptr + count)
                 ctx.stack.push(count);
             } break;
@@ -221,20 +788,15 @@ auto execute_program(bytecode_context& ctx) -> void
                 const auto old_data = ctx.stack.pop<std::byte*>();     // pushed span
                 auto arena = ctx.stack.pop<memory_arena*>();
                 const auto new_count = ctx.stack.pop<std::uint64_t>();
-                const auto size = type_size * new_count;
                 if (new_count <= old_count) {
-                    runtime_error("invalid use of new, can only realloc to grow, old={} new={}", old_count, new_count);
+                    runtime_error(ctx, "invalid use of new, can only realloc to grow, old={} new={}", old_count, new_count);
                 }
-                if (arena->next + size > arena->data.size()) {
-                    runtime_error("arena overflow");
-                }
-                const auto new_data = &arena->data[arena->next];
+                const auto new_data = arena_allocate(ctx, *arena, type_size * new_count);
                 std::memcpy(new_data, old_data, type_size * old_count);
                 for (size_t i = old_count; i != new_count; ++i) {
                     ctx.stack.save(new_data + i * type_size, type_size);
                 }
                 ctx.stack.pop_n(type_size);
-                arena->next += size;
                 ctx.stack.push(new_data); // push the span (ptr + count)
                 ctx.stack.push(new_count);
             } break;
@@ -256,10 +818,21 @@ auto execute_program(bytecode_context& ctx) -> void
             } break;
             case op::ret: {
                 const auto size = read_advance<std::uint64_t>(ctx);
-                std::memcpy(&ctx.stack.at(frame.base_ptr), &ctx.stack.at(ctx.stack.size() - size), size);
+                tracer.on_return(ctx);
+                const auto src = ctx.stack.size() - size;
+                if (src != frame.base_ptr) {
+                    std::memmove(&ctx.stack.at(frame.base_ptr), &ctx.stack.at(src), size);
+                }
                 ctx.stack.resize(frame.base_ptr + size);
                 ctx.frames.pop_back();
             } break;
+            case op::inline_ret: {
+                const auto offset = read_advance<std::uint64_t>(ctx);
+                const auto size = read_advance<std::uint64_t>(ctx);
+                const auto dst = frame.base_ptr + offset;
+                std::memmove(&ctx.stack.at(dst), &ctx.stack.at(ctx.stack.size() - size), size);
+                ctx.stack.resize(dst + size);
+            } break;
             case op::call_static: {
                 const auto function_id = read_advance<std::uint64_t>(ctx);
                 const auto args_size = read_advance<std::uint64_t>(ctx);
@@ -268,25 +841,48 @@ auto execute_program(bytecode_context& ctx) -> void
                     .ip = ctx.functions[function_id].code.data(),
                     .base_ptr = ctx.stack.size() - args_size
                 });
+                tracer.on_call(ctx, function_id);
             } break;
             case op::call_ptr: {
                 const auto args_size = read_advance<std::uint64_t>(ctx);
+                read_advance<std::uint64_t>(ctx); // return size, only used by the inliner
                 const auto function_id = ctx.stack.pop<std::uint64_t>();
                 ctx.frames.push_back(call_frame{
                     .code = ctx.functions[function_id].code.data(),
                     .ip = ctx.functions[function_id].code.data(),
                     .base_ptr = ctx.stack.size() - args_size
                 });
+                tracer.on_call(ctx, function_id);
+            } break;
+            case op::push_temp: {
+                const auto size = read_advance<std::uint64_t>(ctx);
+                const auto distance = read_advance<std::uint64_t>(ctx);
+                const auto src = ctx.stack.size() - size;
+                std::byte* ptr = &ctx.stack.at(src - distance);
+                std::memcpy(ptr, &ctx.stack.at(src), size);
+                ctx.stack.pop_n(size);
+                ctx.stack.push(ptr);
+            } break;
+            case op::pop_temps: {
+                const auto temps_size = read_advance<std::uint64_t>(ctx);
+                const auto value_size = read_advance<std::uint64_t>(ctx);
+                const auto src = ctx.stack.size() - value_size;
+                std::memmove(&ctx.stack.at(src - temps_size), &ctx.stack.at(src), value_size);
+                ctx.stack.resize(ctx.stack.size() - temps_size);
             } break;
             case op::assert: {
                 const auto index = read_advance<std::uint64_t>(ctx);
                 const auto size = read_advance<std::uint64_t>(ctx);
                 if (!ctx.stack.pop<bool>()) {
                     const auto data = &ctx.rom[index];
-                    runtime_error("{}", std::string_view{data, size});
+                    runtime_error(ctx, "{}", std::string_view{data, size});
                 }
             } break;
 
+            case op::program_args: {
+                ctx.stack.push(ctx.args.data());
+                ctx.stack.push(std::uint64_t{ctx.args.size()});
+            } break;
             case op::read_file: {
                 auto arena = ctx.stack.pop<memory_arena*>();
                 const auto filename_size = ctx.stack.pop<std::uint64_t>();
@@ -294,22 +890,22 @@ auto execute_program(bytecode_context& ctx) -> void
                 const auto file = std::string{filename_data, filename_size};
                 const auto handle = std::fopen(file.c_str(), "rb");
                 if (!handle) {
-                    std::print("failed to open\n");
-                    std::exit(1);
+                    runtime_error(ctx, "could not open '{}'", file);
                 }
                 std::fseek(handle, 0, SEEK_END);
                 const auto ssize = std::ftell(handle);
                 if (ssize == -1) {
-                    std::print("Error with ftell\n");
-                    std::exit(1);
+                    runtime_error(ctx, "could not get the size of '{}'", file);
                 }
                 const auto size = static_cast<std::size_t>(ssize);
+                if (arena->next + size > arena->data.size()) {
+                    runtime_error(ctx, "arena overflow, '{}' is {} bytes", file, size);
+                }
                 std::rewind(handle);
                 std::byte* ptr = &arena->data[arena->next];
                 const auto bytes_read = std::fread(ptr, sizeof(std::byte), ssize, handle);
-                if (bytes_read != ssize) {
-                    std::print("Error with fread\n");
-                    std::exit(1);
+                if (bytes_read != size) {
+                    runtime_error(ctx, "could not read '{}'", file);
                 }	
                 arena->next += size;
 
@@ -317,6 +913,237 @@ auto execute_program(bytecode_context& ctx) -> void
                 ctx.stack.push(ptr);  // push the
                 ctx.stack.push(size); // span
             } break;
+            case op::map_file: {
+                auto arena = ctx.stack.pop<memory_arena*>();
+                const auto filename_size = ctx.stack.pop<std::uint64_t>();
+                const auto filename_data = ctx.stack.pop<char*>();
+                const auto file = std::string{filename_data, filename_size};
+                auto& mapping = arena->mapped_files.emplace_back();
+                if (!mapping.open(file)) {
+                    runtime_error(ctx, "could not open '{}'", file);
+                }
+                ctx.stack.push(mapping.data());
+                ctx.stack.push(mapping.size());
+            } break;
+            case op::open_reader: {
+                auto arena = ctx.stack.pop<memory_arena*>();
+                const auto filename_size = ctx.stack.pop<std::uint64_t>();
+                const auto filename_data = ctx.stack.pop<char*>();
+                const auto file = std::string{filename_data, filename_size};
+                auto reader = std::make_unique<line_reader>(file);
+                if (!reader->is_open()) {
+                    runtime_error(ctx, "could not open '{}'", file);
+                }
+                const auto handle = std::uint64_t{ctx.readers.size()};
+                ctx.readers.push_back(std::move(reader));
+                arena->readers.push_back(handle);
+                ctx.stack.push(handle);
+            } break;
+            case op::reader_valid: {
+                auto& reader = reader_for(ctx, ctx.stack.pop<std::uint64_t>());
+                const auto valid = reader.has_line();
+                if (reader.has_error()) {
+                    runtime_error(ctx, "error while reading");
+                }
+                ctx.stack.push(valid);
+            } break;
+            case op::read_line: {
+                auto& reader = reader_for(ctx, ctx.stack.pop<std::uint64_t>());
+                const auto line = reader.next_line();
+                ctx.stack.push(line.data());
+                ctx.stack.push(line.size());
+            } break;
+            case op::open_write: {
+                auto arena = ctx.stack.pop<memory_arena*>();
+                const auto filename_size = ctx.stack.pop<std::uint64_t>();
+                const auto filename_data = ctx.stack.pop<char*>();
+                const auto file = std::string{filename_data, filename_size};
+                auto writer = std::make_unique<file_writer>(file);
+                if (!writer->is_open()) {
+                    runtime_error(ctx, "could not open '{}' for writing", file);
+                }
+                const auto handle = std::uint64_t{ctx.writers.size()};
+                ctx.writers.push_back(std::move(writer));
+                arena->writers.push_back(handle);
+                ctx.stack.push(handle);
+            } break;
+            case op::write: {
+                const auto size = ctx.stack.pop<std::uint64_t>();
+                const auto data = ctx.stack.pop<const char*>();
+                writer_for(ctx, ctx.stack.pop<std::uint64_t>()).write({data, size});
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::write_i64: {
+                const auto value = ctx.stack.pop<std::int64_t>();
+                writer_for(ctx, ctx.stack.pop<std::uint64_t>()).write_number(value);
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::write_f64: {
+                const auto value = ctx.stack.pop<double>();
+                writer_for(ctx, ctx.stack.pop<std::uint64_t>()).write_number(value);
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::close: {
+                auto& writer = writer_handle(ctx, ctx.stack.pop<std::uint64_t>());
+                if (!writer.close()) {
+                    runtime_error(ctx, "failed to write to file");
+                }
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+
+            case op::find: {
+                const auto start = ctx.stack.pop<std::uint64_t>();
+                const auto needle_size = ctx.stack.pop<std::uint64_t>();
+                const auto needle_data = ctx.stack.pop<const char*>();
+                const auto haystack_size = ctx.stack.pop<std::uint64_t>();
+                const auto haystack_data = ctx.stack.pop<const char*>();
+                const auto haystack = std::string_view{haystack_data, haystack_size};
+                ctx.stack.push(find_substring(haystack, {needle_data, needle_size}, start));
+            } break;
+            case op::find_char: {
+                const auto start = ctx.stack.pop<std::uint64_t>();
+                const auto c = ctx.stack.pop<char>();
+                const auto haystack_size = ctx.stack.pop<std::uint64_t>();
+                const auto haystack_data = ctx.stack.pop<const char*>();
+                ctx.stack.push(find_char({haystack_data, haystack_size}, c, start));
+            } break;
+
+            case op::parse_i64: { parse_number<std::int64_t>(ctx); } break;
+            case op::parse_u64: { parse_number<std::uint64_t>(ctx); } break;
+            case op::parse_f64: { parse_number<double>(ctx); } break;
+
+            case op::sort: {
+                const auto key = static_cast<sort_key>(read_advance<std::uint64_t>(ctx));
+                const auto count = ctx.stack.pop<std::uint64_t>();
+                const auto data = ctx.stack.pop<std::byte*>();
+                sort_span(key, data, count);
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::sort_by: {
+                const auto key = static_cast<sort_key>(read_advance<std::uint64_t>(ctx));
+                const auto type_size = read_advance<std::uint64_t>(ctx);
+                const auto offset = ctx.stack.pop<std::uint64_t>();
+                const auto count = ctx.stack.pop<std::uint64_t>();
+                const auto data = ctx.stack.pop<std::byte*>();
+                if (offset + key_size(key) > type_size) {
+                    runtime_error(ctx, "sort key at offset {} does not fit in an element of size {}", offset, type_size);
+                }
+                sort_span_by(key, data, count, type_size, offset);
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+
+            case op::hash_bytes: {
+                const auto type_size = read_advance<std::uint64_t>(ctx);
+                const auto count = ctx.stack.pop<std::uint64_t>();
+                const auto data = ctx.stack.pop<const std::byte*>();
+                ctx.stack.push(hash_bytes(data, count * type_size));
+            } break;
+
+            case op::span_sum: {
+                const auto type = static_cast<numeric_type>(read_advance<std::uint64_t>(ctx));
+                with_numeric_type(type, [&]<typename T>(T) {
+                    const auto count = ctx.stack.pop<std::uint64_t>();
+                    const auto data = ctx.stack.pop<const std::byte*>();
+                    ctx.stack.push(kernels_for<T>().sum(data, count));
+                });
+            } break;
+            case op::span_min:
+            case op::span_max: {
+                const auto type = static_cast<numeric_type>(read_advance<std::uint64_t>(ctx));
+                with_numeric_type(type, [&]<typename T>(T) {
+                    const auto count = ctx.stack.pop<std::uint64_t>();
+                    const auto data = ctx.stack.pop<const std::byte*>();
+                    if (count == 0) {
+                        runtime_error(ctx, "@{} requires a span that is not empty", op_code == op::span_min ? "min" : "max");
+                    }
+                    const auto& kernels = kernels_for<T>();
+                    ctx.stack.push(op_code == op::span_min ? kernels.min(data, count) : kernels.max(data, count));
+                });
+            } break;
+            case op::span_count_eq: {
+                const auto type = static_cast<numeric_type>(read_advance<std::uint64_t>(ctx));
+                with_numeric_type(type, [&]<typename T>(T) {
+                    const auto value = ctx.stack.pop<T>();
+                    const auto count = ctx.stack.pop<std::uint64_t>();
+                    const auto data = ctx.stack.pop<const std::byte*>();
+                    ctx.stack.push(kernels_for<T>().count_eq(data, count, value));
+                });
+            } break;
+            case op::span_dot: {
+                const auto type = static_cast<numeric_type>(read_advance<std::uint64_t>(ctx));
+                with_numeric_type(type, [&]<typename T>(T) {
+                    const auto rhs_count = ctx.stack.pop<std::uint64_t>();
+                    const auto rhs = ctx.stack.pop<const std::byte*>();
+                    const auto lhs_count = ctx.stack.pop<std::uint64_t>();
+                    const auto lhs = ctx.stack.pop<const std::byte*>();
+                    check_same_length(ctx, "dot", lhs_count, rhs_count);
+                    ctx.stack.push(kernels_for<T>().dot(lhs, rhs, lhs_count));
+                });
+            } break;
+            case op::span_add:
+            case op::span_mul: {
+                const auto type = static_cast<numeric_type>(read_advance<std::uint64_t>(ctx));
+                with_numeric_type(type, [&]<typename T>(T) {
+                    const auto rhs_count = ctx.stack.pop<std::uint64_t>();
+                    const auto rhs = ctx.stack.pop<const std::byte*>();
+                    const auto lhs_count = ctx.stack.pop<std::uint64_t>();
+                    const auto lhs = ctx.stack.pop<const std::byte*>();
+                    const auto dst_count = ctx.stack.pop<std::uint64_t>();
+                    const auto dst = ctx.stack.pop<std::byte*>();
+                    const auto name = op_code == op::span_add ? "add" : "mul";
+                    check_same_length(ctx, name, dst_count, lhs_count);
+                    check_same_length(ctx, name, dst_count, rhs_count);
+                    const auto& kernels = kernels_for<T>();
+                    (op_code == op::span_add ? kernels.add : kernels.mul)(dst, lhs, rhs, dst_count);
+                });
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::span_scale: {
+                const auto type = static_cast<numeric_type>(read_advance<std::uint64_t>(ctx));
+                with_numeric_type(type, [&]<typename T>(T) {
+                    const auto factor = ctx.stack.pop<T>();
+                    const auto src_count = ctx.stack.pop<std::uint64_t>();
+                    const auto src = ctx.stack.pop<const std::byte*>();
+                    const auto dst_count = ctx.stack.pop<std::uint64_t>();
+                    const auto dst = ctx.stack.pop<std::byte*>();
+                    check_same_length(ctx, "scale", dst_count, src_count);
+                    kernels_for<T>().scale(dst, src, factor, dst_count);
+                });
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+
+            case op::spawn: {
+                const auto args_size = read_advance<std::uint64_t>(ctx);
+                const auto function_id = ctx.stack.pop<std::uint64_t>();
+                ctx.stack.push(spawn_thread(ctx, function_id, args_size));
+            } break;
+            case op::join: {
+                join_thread(ctx, ctx.stack.pop<std::uint64_t>());
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::atomic_load: {
+                const auto ptr = ctx.stack.pop<std::byte*>();
+                ctx.stack.push(atomic_at(ctx, ptr).load());
+            } break;
+            case op::atomic_store: {
+                const auto value = ctx.stack.pop<std::uint64_t>();
+                const auto ptr = ctx.stack.pop<std::byte*>();
+                atomic_at(ctx, ptr).store(value);
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
+            case op::atomic_fetch_add: {
+                const auto value = ctx.stack.pop<std::uint64_t>();
+                const auto ptr = ctx.stack.pop<std::byte*>();
+                ctx.stack.push(atomic_at(ctx, ptr).fetch_add(value));
+            } break;
+            case op::parallel_for: {
+                const auto type_size = read_advance<std::uint64_t>(ctx);
+                const auto function_id = ctx.stack.pop<std::uint64_t>();
+                const auto count = ctx.stack.pop<std::uint64_t>();
+                const auto data = ctx.stack.pop<std::byte*>();
+                parallel_for(ctx, data, count, type_size, function_id);
+                ctx.stack.push(std::byte{0}); // returns null
+            } break;
 
             case op::null_to_i64: {
                 const auto value = ctx.stack.pop<std::byte>();
@@ -426,41 +1253,48 @@ auto execute_program(bytecode_context& ctx) -> void
             case op::i64_neg: { unary_op<std::int64_t, std::negate>(ctx); } break;
             case op::f64_neg: { unary_op<double, std::negate>(ctx); } break;
 
-            case op::print_null: {
-                ctx.stack.pop<std::byte>(); // pops the null byte
-                std::print("null");
-            } break;
-            case op::print_bool: {
-                const auto b = ctx.stack.pop<bool>();
-                std::print("{}", b ? "true" : "false");
-            } break;
-            case op::print_char: {
-                const auto c = ctx.stack.pop<char>();
-                std::print("{}", c);
-            } break;
-            case op::print_i32: { print_value<std::int32_t>(ctx); } break;
-            case op::print_i64: { print_value<std::int64_t>(ctx); } break;
-            case op::print_u64: { print_value<std::uint64_t>(ctx); } break;
-            case op::print_f64: { print_value<double>(ctx); } break;
-            case op::print_char_span: {
-                const auto size = ctx.stack.pop<std::uint64_t>();
-                const auto ptr = ctx.stack.pop<const char*>();
-                std::print("{}", std::string_view{ptr, size});
+            case op::f64_sqrt: { math_op(ctx, [](double x) { return std::sqrt(x); }); } break;
+            case op::f64_floor: { math_op(ctx, [](double x) { return std::floor(x); }); } break;
+            case op::f64_ceil: { math_op(ctx, [](double x) { return std::ceil(x); }); } break;
+            case op::f64_round: { math_op(ctx, [](double x) { return std::round(x); }); } break;
+            case op::f64_abs: { math_op(ctx, [](double x) { return std::fabs(x); }); } break;
+            case op::f64_exp: { math_op(ctx, [](double x) { return std::exp(x); }); } break;
+            case op::f64_log: { math_op(ctx, [](double x) { return std::log(x); }); } break;
+            case op::f64_sin: { math_op(ctx, [](double x) { return std::sin(x); }); } break;
+            case op::f64_cos: { math_op(ctx, [](double x) { return std::cos(x); }); } break;
+            case op::f64_pow: { math_op(ctx, [](double x, double y) { return std::pow(x, y); }); } break;
+            case op::f64_min: { math_op(ctx, [](double x, double y) { return std::fmin(x, y); }); } break;
+            case op::f64_max: { math_op(ctx, [](double x, double y) { return std::fmax(x, y); }); } break;
+            case op::f64_fma: { math_op(ctx, [](double x, double y, double z) { return std::fma(x, y, z); }); } break;
+
+            case op::print_fmt: {
+                const auto index = read_advance<std::uint64_t>(ctx);
+                const auto size = read_advance<std::uint64_t>(ctx);
+                const auto args_size = read_advance<std::uint64_t>(ctx);
+                const auto args = &ctx.stack.at(ctx.stack.size() - args_size);
+                print_formatted(std::string_view{&ctx.rom[index], size}, args);
+                ctx.stack.pop_n(args_size);
             } break;
-            case op::print_ptr: {
-                const auto ptr = ctx.stack.pop<std::uint64_t>();
-                std::print("{:#018x}", ptr);
-            } break; 
 
-            default: { runtime_error("unknown op code! ({})", static_cast<int>(op_code)); } break;
+            default: { runtime_error(ctx, "unknown op code! ({})", static_cast<int>(op_code)); } break;
         }
     }
 }
 
-template <bool Debug>
-auto run(const bytecode_program& prog) -> void
+template <typename Tracer>
+auto run(const bytecode_program& prog, Tracer& tracer, std::span<const std::string> args) -> void
 {
-    bytecode_context ctx{prog.functions, prog.rom};
+    auto arg_spans = std::vector<char_span>{};
+    for (const auto& arg : args) {
+        arg_spans.push_back({arg.data(), arg.size()});
+    }
+
+    thread_registry threads;
+    bytecode_context ctx{prog.functions, prog.rom, prog.modules, threads, arg_spans};
+
+    // Threads may point into the stack and arenas of the context, so they must be stopped
+    // before it goes away, even if the program fails
+    const auto join_threads = scope_exit{[&] { join_all_threads(threads); }};
     ctx.frames.reserve(1000);
     ctx.frames.emplace_back(call_frame{
         .code = ctx.functions.front().code.data(),
@@ -468,7 +1302,11 @@ auto run(const bytecode_program& prog) -> void
         .base_ptr = 0
     });
 
-    execute_program<Debug>(ctx);
+    tracer.on_call(ctx, 0);
+    execute_program(ctx, tracer);
+    join_all_threads(threads);
+    rethrow_thread_error(threads);
+    program_output().flush();
 
     if (ctx.stack.size() > 0) {
         std::print("\n -> Stack Size: {}, bug in the compiler!\n", ctx.stack.size());
@@ -478,7 +1316,7 @@ auto run(const bytecode_program& prog) -> void
 }
 
 vm_stack::vm_stack(std::size_t size)
-    : d_data{std::make_unique<std::byte[]>(size)}
+    : d_data{std::make_unique_for_overwrite<std::byte[]>(size)} // no need to pay for zeroing
     , d_max_size{size}
     , d_current_size{0}
 {}
@@ -486,8 +1324,8 @@ vm_stack::vm_stack(std::size_t size)
 auto vm_stack::push(const std::byte* src, std::size_t count) -> void
 {
     if (d_current_size + count > d_max_size) {
-        std::print("Stack overflow (current_size={}, count={}, max_size={}\n", d_current_size, count, d_max_size);
-        std::exit(27);
+        program_output().flush();
+        panic("stack overflow (current_size={}, count={}, max_size={})", d_current_size, count, d_max_size);
     }
     std::memcpy(&d_data[d_current_size], src, count);
     d_current_size += count;
@@ -502,8 +1340,8 @@ auto vm_stack::pop_and_save(std::byte* dst, std::size_t count) -> void
 auto vm_stack::save(std::byte* dst, std::size_t count) -> void
 {
     if (d_current_size < count) {
-        std::print("Stack underflow\n");
-        std::exit(28);
+        program_output().flush();
+        panic("stack underflow");
     }
     std::memcpy(dst, &d_data[d_current_size - count], count);
 }
@@ -521,14 +1359,49 @@ auto vm_stack::print() const -> void
     std::print("\n");
 }
 
-auto run_program(const bytecode_program& prog) -> void
+auto run_program(const bytecode_program& prog, std::span<const std::string> args) -> void
+{
+    auto tracer = no_tracer{};
+    run(prog, tracer, args);
+}
+
+auto run_program_debug(const bytecode_program& prog, std::span<const std::string> args) -> void
+{
+    auto tracer = debug_tracer{};
+    run(prog, tracer, args);
+}
+
+auto run_program_profile(
+    const bytecode_program& prog,
+    const std::filesystem::path& stacks_file,
+    std::span<const std::string> args
+)
+    -> void
+{
+    auto tracer = profiler{prog.functions.size()};
+    run(prog, tracer, args);
+    tracer.report(prog, stacks_file);
+}
+
+auto run_program_sample(const bytecode_program& prog, std::span<const std::string> args) -> void
 {
-    run<false>(prog);
+    auto tracer = sampler{prog.functions.size()};
+    run(prog, tracer, args);
+    tracer.report(prog);
 }
 
-auto run_program_debug(const bytecode_program& prog) -> void
+auto run_program_perf_counters(const bytecode_program& prog, std::span<const std::string> args) -> void
 {
-    run<true>(prog);
+    auto tracer = counter_profiler{prog.functions.size()};
+    run(prog, tracer, args);
+    tracer.report(prog);
 }
 
-}
\ No newline at end of file
+auto run_program_stats(const bytecode_program& prog, std::span<const std::string> args) -> runtime_stats
+{
+    auto tracer = stats_tracer{};
+    run(prog, tracer, args);
+    return tracer.stats;
+}
+
+}
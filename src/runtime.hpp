@@ -1,21 +1,38 @@
 #pragma once
 #include <array>
 #include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <print>
 #include <cstring>
+#include <filesystem>
 #include <memory>
+#include <span>
 #include <unordered_set>
 
 #include "bytecode.hpp"
+#include "utility/file_writer.hpp"
+#include "utility/line_reader.hpp"
+#include "utility/mapped_file.hpp"
+#include "utility/output_buffer.hpp"
 
 namespace anzu {
 
+// A char const[] as laid out in the VM, used to pass the program its command line args
+struct char_span
+{
+    const char*   data;
+    std::uint64_t size;
+};
+
 struct call_frame
 {
-    std::byte* code = nullptr; // start of the current chunk of bytecode
-    std::byte* ip = nullptr; // instruction pointer
+    const std::byte* code = nullptr; // start of the current chunk of bytecode
+    const std::byte* ip = nullptr; // instruction pointer
     std::size_t base_ptr = 0;
 };
 
@@ -55,25 +72,78 @@ public:
 
 struct memory_arena
 {
-    std::array<std::byte, 1024 * 1024 * 64> data; // 64MB;
+    alignas(8) std::array<std::byte, 1024 * 1024 * 64> data; // 64MB;
     std::size_t next = 0;
     std::size_t index = 0; // position of the arena in the arena vector
+    std::vector<mapped_file> mapped_files = {}; // from @map_file, released with the arena
+    std::vector<std::uint64_t> readers = {}; // handles from @open_reader, closed with the arena
+    std::vector<std::uint64_t> writers = {}; // handles from @open_write, closed with the arena
 };
 
+// The threads started by @spawn during a run of a program. A handle is an index into the
+// threads, and joining moves the thread out, leaving an empty one in its place. The first
+// error thrown on any of the threads is kept and rethrown by the next join. The threads are
+// declared last so that they are joined before the mutex and error that they use go away.
+struct thread_registry
+{
+    std::mutex               mutex;
+    std::exception_ptr       error;
+    std::deque<std::jthread> threads;
+};
+
+// The state of a single execution of a program. The program itself is only referenced, so
+// it must outlive the context, and many contexts may run the same program concurrently.
+// Each spawned thread gets its own context sharing the program and the thread registry.
 struct bytecode_context
 {
-    std::vector<bytecode_function> functions;
-    std::string                    rom;
+    const std::vector<bytecode_function>& functions;
+    const std::string&                    rom;
+    const std::vector<std::string>&       modules;
+    thread_registry&                      threads;
+    std::span<const char_span>            args; // returned by @args
 
     std::vector<call_frame> frames = {};
     vm_stack                stack  = {};
 
+    // Files opened on this thread. A handle is an index into these, and deleting the arena
+    // that owns a file leaves an empty pointer in its place so that stale handles are caught.
+    std::vector<std::unique_ptr<line_reader>> readers = {};
+    std::vector<std::unique_ptr<file_writer>> writers = {};
+
     std::vector<std::unique_ptr<memory_arena>> arenas          = {};
     std::vector<std::size_t>                   arena_free_list = {};
+};
 
+// Statistics gathered while running a program, reported by the --stats flag
+struct runtime_stats
+{
+    std::size_t peak_stack_bytes = 0;
+    std::size_t arenas_created   = 0;
+    std::size_t arena_peak_bytes = 0; // the most memory used by a single arena
 };
 
-auto run_program(const bytecode_program& prog) -> void;
-auto run_program_debug(const bytecode_program& prog) -> void;
+// Runs the program with the given command line args, which it can read with @args. The other
+// ways of running a program below take the same args.
+auto run_program(const bytecode_program& prog, std::span<const std::string> args = {}) -> void;
+auto run_program_debug(const bytecode_program& prog, std::span<const std::string> args = {}) -> void;
+
+// Runs the program while timing every call, then prints a report and writes the time spent in
+// each call stack to the given file in the collapsed stack format used by flamegraph tools
+auto run_program_profile(
+    const bytecode_program& prog,
+    const std::filesystem::path& stacks_file,
+    std::span<const std::string> args = {}
+) -> void;
+
+// Runs the program while periodically sampling the instruction being executed, then prints
+// the source lines where the most samples landed
+auto run_program_sample(const bytecode_program& prog, std::span<const std::string> args = {}) -> void;
+
+// Runs the program while reading the hardware performance counters on every call and
+// return, then prints the counts for each function
+auto run_program_perf_counters(const bytecode_program& prog, std::span<const std::string> args = {}) -> void;
+
+// Runs the program while tracking its memory usage
+auto run_program_stats(const bytecode_program& prog, std::span<const std::string> args = {}) -> runtime_stats;
 
 }
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "server.hpp"
+#include "parser.hpp"
+#include "runtime.hpp"
+#include "utility/common.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <print>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define ANZU_HAS_UNIX_SOCKETS
+#endif
+
+namespace anzu {
+
+#ifdef ANZU_HAS_UNIX_SOCKETS
+namespace {
+
+// The client's stdin, stdout and stderr are sent along with the header
+constexpr auto num_fds = std::size_t{3};
+
+// Followed by the working directory, the script and then the args, each arg terminated by
+// a null character
+struct request_header
+{
+    std::uint32_t cwd_size;
+    std::uint32_t file_size;
+    std::uint32_t args_size;
+};
+
+struct cached_program
+{
+    std::size_t                                                hash;
+    std::vector<std::pair<std::filesystem::path, std::size_t>> imports; // hash of each import
+    bytecode_program                                           program;
+};
+
+auto content_hash(std::string_view contents) -> std::size_t
+{
+    return std::hash<std::string_view>{}(contents);
+}
+
+auto read_contents(const std::filesystem::path& file) -> std::optional<std::string>
+{
+    auto stream = std::ifstream{file};
+    if (!stream) return std::nullopt;
+    auto contents = std::stringstream{};
+    contents << stream.rdbuf();
+    return contents.str();
+}
+
+// The hash of an imported module as the parser would load it
+auto import_hash(const std::filesystem::path& path) -> std::size_t
+{
+    if (const auto contents = read_contents(path)) return content_hash(*contents);
+    return 0;
+}
+
+auto is_fresh(const cached_program& entry, std::size_t hash) -> bool
+{
+    if (entry.hash != hash) return false;
+    for (const auto& [path, import] : entry.imports) {
+        if (import_hash(path) != import) return false;
+    }
+    return true;
+}
+
+auto compile_source(const std::string& source, const compile_options& options) -> cached_program
+{
+    auto ast = parse_source(source);
+    auto imports = parse_imports(ast);
+    auto import_hashes = std::vector<std::pair<std::filesystem::path, std::size_t>>{};
+    for (const auto& [path, mod] : imports) {
+        import_hashes.emplace_back(path, import_hash(path));
+    }
+    auto program = compile(ast, std::move(imports), options);
+    return cached_program{
+        .hash = content_hash(source),
+        .imports = std::move(import_hashes),
+        .program = std::move(program)
+    };
+}
+
+auto write_all(int fd, const void* data, std::size_t size) -> bool
+{
+    auto ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        const auto written = write(fd, ptr, size);
+        if (written <= 0) return false;
+        ptr += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+auto read_all(int fd, void* data, std::size_t size) -> bool
+{
+    auto ptr = static_cast<char*>(data);
+    while (size > 0) {
+        const auto count = read(fd, ptr, size);
+        if (count <= 0) return false;
+        ptr += count;
+        size -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+auto send_status(int conn, std::int32_t status) -> void
+{
+    write_all(conn, &status, sizeof(status));
+}
+
+auto report_error(int fd, std::string_view message) -> void
+{
+    const auto line = std::format("anzu serve: {}\n", message);
+    write_all(fd, line.data(), line.size());
+}
+
+// Receives the request header along with the client's file descriptors
+auto receive_header(int conn, request_header& header, std::array<int, num_fds>& fds) -> bool
+{
+    auto iov = iovec{.iov_base = &header, .iov_len = sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_fds)] = {};
+    auto msg = msghdr{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(conn, &msg, 0) != sizeof(header)) return false;
+
+    const auto cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * num_fds)) {
+        return false;
+    }
+    std::memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * num_fds);
+    return true;
+}
+
+auto send_header(int conn, const request_header& header, const std::array<int, num_fds>& fds) -> bool
+{
+    auto iov = iovec{.iov_base = const_cast<request_header*>(&header), .iov_len = sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_fds)] = {};
+    auto msg = msghdr{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    const auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * num_fds);
+    return sendmsg(conn, &msg, 0) == sizeof(header);
+}
+
+auto encode_args(std::span<const std::string> args) -> std::string
+{
+    auto data = std::string{};
+    for (const auto& arg : args) {
+        data += arg;
+        data += '\0';
+    }
+    return data;
+}
+
+auto decode_args(std::string_view data) -> std::vector<std::string>
+{
+    auto args = std::vector<std::string>{};
+    while (!data.empty()) {
+        const auto end = data.find('\0');
+        if (end == std::string_view::npos) break;
+        args.emplace_back(data.substr(0, end));
+        data.remove_prefix(end + 1);
+    }
+    return args;
+}
+
+// Returns the user id of the process on the other end of the connection
+auto peer_uid(int conn) -> std::optional<uid_t>
+{
+#if defined(__linux__)
+    auto cred = ucred{};
+    auto size = socklen_t{sizeof(cred)};
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &size) != 0) return std::nullopt;
+    return cred.uid;
+#else
+    auto uid = uid_t{};
+    auto gid = gid_t{};
+    if (getpeereid(conn, &uid, &gid) != 0) return std::nullopt;
+    return uid;
+#endif
+}
+
+// Runs the given function in a detached grandchild process so that the server never has
+// to reap it and can move straight on to the next request
+template <typename Func>
+auto run_detached(Func&& func) -> void
+{
+    std::fflush(stdout);
+    const auto pid = fork();
+    if (pid == -1) return;
+    if (pid == 0) {
+        if (fork() == 0) {
+            func();
+        }
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+auto handle_request(
+    int listener,
+    int conn,
+    std::unordered_map<std::string, cached_program>& cache,
+    const compile_options& options
+)
+    -> void
+{
+    auto header = request_header{};
+    auto fds = std::array<int, num_fds>{-1, -1, -1};
+    const auto cleanup = scope_exit{[&] {
+        for (const auto fd : fds) {
+            if (fd != -1) close(fd);
+        }
+        close(conn);
+    }};
+    if (!receive_header(conn, header, fds)) return;
+
+    auto cwd = std::string(header.cwd_size, '\0');
+    auto file = std::string(header.file_size, '\0');
+    auto args_data = std::string(header.args_size, '\0');
+    if (!read_all(conn, cwd.data(), cwd.size()) || !read_all(conn, file.data(), file.size())
+        || !read_all(conn, args_data.data(), args_data.size()))
+    {
+        return;
+    }
+    const auto args = decode_args(args_data);
+
+    // Imports are relative to the working directory, so the client's must be used
+    if (chdir(cwd.c_str()) != 0) {
+        report_error(fds[2], std::format("could not change to directory '{}'", cwd));
+        send_status(conn, 1);
+        return;
+    }
+    const auto source = read_contents(file);
+    if (!source) {
+        report_error(fds[2], std::format("could not read '{}'", file));
+        send_status(conn, 1);
+        return;
+    }
+
+    const auto key = cwd + '\n' + file;
+    auto it = cache.find(key);
+    if (it == cache.end() || !is_fresh(it->second, content_hash(*source))) {
+        try {
+            it = cache.insert_or_assign(key, compile_source(*source, options)).first;
+        } catch (const error& e) { // compile errors go to the client's stderr
+            const auto message = std::format("{}\n", e.what());
+            write_all(fds[2], message.data(), message.size());
+            send_status(conn, 1);
+            return;
+        }
+    }
+
+    const auto& program = it->second.program;
+    run_detached([&] {
+        close(listener);
+        dup2(fds[0], STDIN_FILENO);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[2], STDERR_FILENO);
+        auto status = std::int32_t{0};
+        try {
+            run_program(program, args);
+        } catch (const error& e) { // reported the same way as when running without the server
+            std::print("{}\n", e.what());
+            status = 1;
+        }
+        std::fflush(stdout);
+        send_status(conn, status);
+        _exit(0);
+    });
+}
+
+}
+
+auto serve(const std::filesystem::path& socket_path, const compile_options& options) -> int
+{
+    const auto listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    auto address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    const auto path = socket_path.string();
+    if (listener == -1 || path.size() >= sizeof(address.sun_path)) {
+        std::print("failed to create socket '{}'\n", path);
+        return 1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // Only the user running the server may connect, since programs run with its permissions.
+    // The socket is created without access for anyone else, and each peer is checked too for
+    // platforms that ignore the permissions of a socket.
+    unlink(path.c_str()); // remove the socket left by a previous server
+    const auto old_mask = umask(0077);
+    const auto bound = bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    umask(old_mask);
+    if (!bound || listen(listener, 64) != 0) {
+        std::print("failed to listen on '{}': {}\n", path, std::strerror(errno));
+        return 1;
+    }
+    std::print("listening on '{}'\n", path);
+    std::fflush(stdout);
+
+    auto cache = std::unordered_map<std::string, cached_program>{};
+    while (true) {
+        const auto conn = accept(listener, nullptr, nullptr);
+        if (conn == -1) continue;
+        if (peer_uid(conn) != getuid()) {
+            close(conn);
+            continue;
+        }
+        handle_request(listener, conn, cache, options);
+    }
+}
+
+auto run_client(
+    const std::filesystem::path& socket_path,
+    const std::filesystem::path& file,
+    std::span<const std::string> args
+)
+    -> int
+{
+    const auto conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    auto address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    const auto path = socket_path.string();
+    if (conn == -1 || path.size() >= sizeof(address.sun_path)) {
+        std::print(stderr, "failed to create socket '{}'\n", path);
+        return 1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    if (connect(conn, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::print(stderr, "failed to connect to '{}': {}\n", path, std::strerror(errno));
+        return 1;
+    }
+
+    const auto cwd = std::filesystem::current_path().string();
+    const auto script = file.string();
+    const auto args_data = encode_args(args);
+    const auto header = request_header{
+        .cwd_size = static_cast<std::uint32_t>(cwd.size()),
+        .file_size = static_cast<std::uint32_t>(script.size()),
+        .args_size = static_cast<std::uint32_t>(args_data.size())
+    };
+    const auto fds = std::array<int, num_fds>{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    if (!send_header(conn, header, fds) || !write_all(conn, cwd.data(), cwd.size())
+        || !write_all(conn, script.data(), script.size())
+        || !write_all(conn, args_data.data(), args_data.size()))
+    {
+        std::print(stderr, "failed to send request to '{}'\n", path);
+        return 1;
+    }
+
+    // The program writes straight to our stdout, so all that is left is to wait for the
+    // exit status. The connection closing without one means that the program failed.
+    auto status = std::int32_t{1};
+    read_all(conn, &status, sizeof(status));
+    close(conn);
+    return status;
+}
+
+#else
+
+auto serve(const std::filesystem::path&, const compile_options&) -> int
+{
+    std::print("serve is only supported on platforms with unix domain sockets\n");
+    return 1;
+}
+
+auto run_client(const std::filesystem::path&, const std::filesystem::path&, std::span<const std::string>) -> int
+{
+    std::print("client is only supported on platforms with unix domain sockets\n");
+    return 1;
+}
+
+#endif
+
+}
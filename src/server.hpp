@@ -0,0 +1,30 @@
+#pragma once
+#include "compiler.hpp"
+
+#include <filesystem>
+#include <span>
+#include <string>
+
+namespace anzu {
+
+// Listens on a unix domain socket and runs programs on behalf of clients, so that repeated
+// runs do not pay for process startup or for compiling the program and its imports. Compiled
+// programs are cached by path and reused until the script or any module it imports changes.
+// Each request runs in a fresh process forked from the server with the client's stdin,
+// stdout and stderr, so a script that fails cannot bring the server down. The socket is only
+// accessible to the user running the server, and connections from other users are refused.
+// Requests are handled one at a time and compiles happen in the accept loop, so a slow
+// compile delays every other client until it finishes. Only returns if the socket cannot be set up.
+auto serve(const std::filesystem::path& socket_path, const compile_options& options) -> int;
+
+// Asks the server listening on the given socket to run a program in this process's working
+// directory, with the given args and this process's stdin, stdout and stderr. Returns the
+// program's exit code.
+auto run_client(
+    const std::filesystem::path& socket_path,
+    const std::filesystem::path& file,
+    std::span<const std::string> args
+)
+    -> int;
+
+}
@@ -0,0 +1,282 @@
+#include "span_kernels.hpp"
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define ANZU_HAS_AVX2_KERNELS
+#endif
+
+// The kernels are written once and inlined into an entry point for each instruction set, so
+// that the compiler vectorises each copy for its own target
+#ifdef ANZU_HAS_AVX2_KERNELS
+#define ANZU_KERNEL_INLINE [[gnu::always_inline]] inline
+#else
+#define ANZU_KERNEL_INLINE inline
+#endif
+
+namespace anzu {
+namespace {
+
+// Enough independent accumulators to fill two AVX2 registers of any of the element types
+constexpr auto lanes = std::size_t{8};
+
+// Integer arithmetic is done unsigned so that overflow wraps rather than being undefined
+template <typename T>
+struct arith { using type = T; };
+
+template <std::integral T>
+struct arith<T> { using type = std::make_unsigned_t<T>; };
+
+template <typename T>
+using arith_t = typename arith<T>::type;
+
+// VM memory is not necessarily aligned for T, so the kernels access their arrays through one
+// of these. Aligned arrays are indexed directly so that they can be vectorised, and anything
+// else is read and written an element at a time with memcpy.
+template <typename T, typename Byte>
+struct aligned_array
+{
+    using value_type = T;
+    Byte* data;
+
+    ANZU_KERNEL_INLINE auto operator[](std::size_t i) const -> T { return reinterpret_cast<const T*>(data)[i]; }
+    ANZU_KERNEL_INLINE auto set(std::size_t i, T value) const -> void { reinterpret_cast<T*>(data)[i] = value; }
+};
+
+template <typename T, typename Byte>
+struct unaligned_array
+{
+    using value_type = T;
+    Byte* data;
+
+    ANZU_KERNEL_INLINE auto operator[](std::size_t i) const -> T
+    {
+        auto value = T{};
+        std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+        return value;
+    }
+    ANZU_KERNEL_INLINE auto set(std::size_t i, T value) const -> void { std::memcpy(data + i * sizeof(T), &value, sizeof(T)); }
+};
+
+template <typename T>
+auto is_aligned(const std::byte* data) -> bool
+{
+    return reinterpret_cast<std::uintptr_t>(data) % alignof(T) == 0;
+}
+
+template <typename Array, typename T = typename Array::value_type>
+ANZU_KERNEL_INLINE auto sum_impl(Array data, std::size_t count) -> T
+{
+    auto acc = std::array<arith_t<T>, lanes>{};
+    auto i = std::size_t{0};
+    for (; i + lanes <= count; i += lanes) {
+        for (std::size_t j = 0; j != lanes; ++j) {
+            acc[j] += static_cast<arith_t<T>>(data[i + j]);
+        }
+    }
+    auto total = arith_t<T>{};
+    for (const auto value : acc) total += value;
+    for (; i != count; ++i) total += static_cast<arith_t<T>>(data[i]);
+    return static_cast<T>(total);
+}
+
+template <typename Array, typename Compare, typename T = typename Array::value_type>
+ANZU_KERNEL_INLINE auto extreme_impl(Array data, std::size_t count, Compare better) -> T
+{
+    auto acc = std::array<T, lanes>{};
+    acc.fill(data[0]);
+    auto i = std::size_t{0};
+    for (; i + lanes <= count; i += lanes) {
+        for (std::size_t j = 0; j != lanes; ++j) {
+            acc[j] = better(data[i + j], acc[j]) ? data[i + j] : acc[j];
+        }
+    }
+    auto result = acc[0];
+    for (const auto value : acc) result = better(value, result) ? value : result;
+    for (; i != count; ++i) result = better(data[i], result) ? data[i] : result;
+    return result;
+}
+
+template <typename Array, typename T = typename Array::value_type>
+ANZU_KERNEL_INLINE auto count_eq_impl(Array data, std::size_t count, T value) -> std::uint64_t
+{
+    auto total = std::uint64_t{0};
+    for (std::size_t i = 0; i != count; ++i) {
+        total += data[i] == value ? 1 : 0;
+    }
+    return total;
+}
+
+template <typename Array, typename T = typename Array::value_type>
+ANZU_KERNEL_INLINE auto dot_impl(Array lhs, Array rhs, std::size_t count) -> T
+{
+    auto acc = std::array<arith_t<T>, lanes>{};
+    auto i = std::size_t{0};
+    for (; i + lanes <= count; i += lanes) {
+        for (std::size_t j = 0; j != lanes; ++j) {
+            acc[j] += static_cast<arith_t<T>>(lhs[i + j]) * static_cast<arith_t<T>>(rhs[i + j]);
+        }
+    }
+    auto total = arith_t<T>{};
+    for (const auto value : acc) total += value;
+    for (; i != count; ++i) total += static_cast<arith_t<T>>(lhs[i]) * static_cast<arith_t<T>>(rhs[i]);
+    return static_cast<T>(total);
+}
+
+template <typename Dst, typename Array, typename Op, typename T = typename Array::value_type>
+ANZU_KERNEL_INLINE auto elementwise_impl(Dst dst, Array lhs, Array rhs, std::size_t count, Op op) -> void
+{
+    for (std::size_t i = 0; i != count; ++i) {
+        dst.set(i, static_cast<T>(op(static_cast<arith_t<T>>(lhs[i]), static_cast<arith_t<T>>(rhs[i]))));
+    }
+}
+
+template <typename Dst, typename Array, typename T = typename Array::value_type>
+ANZU_KERNEL_INLINE auto scale_impl(Dst dst, Array src, T factor, std::size_t count) -> void
+{
+    for (std::size_t i = 0; i != count; ++i) {
+        dst.set(i, static_cast<T>(static_cast<arith_t<T>>(src[i]) * static_cast<arith_t<T>>(factor)));
+    }
+}
+
+struct baseline_target
+{
+    template <typename Array>
+    static auto sum(Array data, std::size_t count) { return sum_impl(data, count); }
+
+    template <typename Array>
+    static auto min(Array data, std::size_t count) { return extreme_impl(data, count, std::less{}); }
+
+    template <typename Array>
+    static auto max(Array data, std::size_t count) { return extreme_impl(data, count, std::greater{}); }
+
+    template <typename Array, typename T>
+    static auto count_eq(Array data, std::size_t count, T value) { return count_eq_impl(data, count, value); }
+
+    template <typename Array>
+    static auto dot(Array lhs, Array rhs, std::size_t count) { return dot_impl(lhs, rhs, count); }
+
+    template <typename Dst, typename Array>
+    static auto add(Dst dst, Array lhs, Array rhs, std::size_t count) { elementwise_impl(dst, lhs, rhs, count, std::plus{}); }
+
+    template <typename Dst, typename Array>
+    static auto mul(Dst dst, Array lhs, Array rhs, std::size_t count) { elementwise_impl(dst, lhs, rhs, count, std::multiplies{}); }
+
+    template <typename Dst, typename Array, typename T>
+    static auto scale(Dst dst, Array src, T factor, std::size_t count) { scale_impl(dst, src, factor, count); }
+};
+
+#ifdef ANZU_HAS_AVX2_KERNELS
+struct avx2_target
+{
+    template <typename Array>
+    [[gnu::target("avx2")]] static auto sum(Array data, std::size_t count) { return sum_impl(data, count); }
+
+    template <typename Array>
+    [[gnu::target("avx2")]] static auto min(Array data, std::size_t count) { return extreme_impl(data, count, std::less{}); }
+
+    template <typename Array>
+    [[gnu::target("avx2")]] static auto max(Array data, std::size_t count) { return extreme_impl(data, count, std::greater{}); }
+
+    template <typename Array, typename T>
+    [[gnu::target("avx2")]] static auto count_eq(Array data, std::size_t count, T value) { return count_eq_impl(data, count, value); }
+
+    template <typename Array>
+    [[gnu::target("avx2")]] static auto dot(Array lhs, Array rhs, std::size_t count) { return dot_impl(lhs, rhs, count); }
+
+    template <typename Dst, typename Array>
+    [[gnu::target("avx2")]] static auto add(Dst dst, Array lhs, Array rhs, std::size_t count) { elementwise_impl(dst, lhs, rhs, count, std::plus{}); }
+
+    template <typename Dst, typename Array>
+    [[gnu::target("avx2")]] static auto mul(Dst dst, Array lhs, Array rhs, std::size_t count) { elementwise_impl(dst, lhs, rhs, count, std::multiplies{}); }
+
+    template <typename Dst, typename Array, typename T>
+    [[gnu::target("avx2")]] static auto scale(Dst dst, Array src, T factor, std::size_t count) { scale_impl(dst, src, factor, count); }
+};
+
+auto has_avx2() -> bool
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// Arrays that are all aligned go to the kernels for the given instruction set, and any others
+// to the scalar ones, which use the same lanes so that the results are the same either way
+template <typename Target, typename T>
+auto make_kernels() -> span_kernels<T>
+{
+    using in = aligned_array<T, const std::byte>;
+    using out = aligned_array<T, std::byte>;
+    using unaligned_in = unaligned_array<T, const std::byte>;
+    using unaligned_out = unaligned_array<T, std::byte>;
+
+    return {
+        .sum = [](const std::byte* data, std::size_t count) -> T {
+            if (is_aligned<T>(data)) return Target::sum(in{data}, count);
+            return baseline_target::sum(unaligned_in{data}, count);
+        },
+        .min = [](const std::byte* data, std::size_t count) -> T {
+            if (is_aligned<T>(data)) return Target::min(in{data}, count);
+            return baseline_target::min(unaligned_in{data}, count);
+        },
+        .max = [](const std::byte* data, std::size_t count) -> T {
+            if (is_aligned<T>(data)) return Target::max(in{data}, count);
+            return baseline_target::max(unaligned_in{data}, count);
+        },
+        .count_eq = [](const std::byte* data, std::size_t count, T value) -> std::uint64_t {
+            if (is_aligned<T>(data)) return Target::count_eq(in{data}, count, value);
+            return baseline_target::count_eq(unaligned_in{data}, count, value);
+        },
+        .dot = [](const std::byte* lhs, const std::byte* rhs, std::size_t count) -> T {
+            if (is_aligned<T>(lhs) && is_aligned<T>(rhs)) return Target::dot(in{lhs}, in{rhs}, count);
+            return baseline_target::dot(unaligned_in{lhs}, unaligned_in{rhs}, count);
+        },
+        .add = [](std::byte* dst, const std::byte* lhs, const std::byte* rhs, std::size_t count) {
+            if (is_aligned<T>(dst) && is_aligned<T>(lhs) && is_aligned<T>(rhs)) {
+                Target::add(out{dst}, in{lhs}, in{rhs}, count);
+            } else {
+                baseline_target::add(unaligned_out{dst}, unaligned_in{lhs}, unaligned_in{rhs}, count);
+            }
+        },
+        .mul = [](std::byte* dst, const std::byte* lhs, const std::byte* rhs, std::size_t count) {
+            if (is_aligned<T>(dst) && is_aligned<T>(lhs) && is_aligned<T>(rhs)) {
+                Target::mul(out{dst}, in{lhs}, in{rhs}, count);
+            } else {
+                baseline_target::mul(unaligned_out{dst}, unaligned_in{lhs}, unaligned_in{rhs}, count);
+            }
+        },
+        .scale = [](std::byte* dst, const std::byte* src, T factor, std::size_t count) {
+            if (is_aligned<T>(dst) && is_aligned<T>(src)) {
+                Target::scale(out{dst}, in{src}, factor, count);
+            } else {
+                baseline_target::scale(unaligned_out{dst}, unaligned_in{src}, factor, count);
+            }
+        }
+    };
+}
+}
+
+template <typename T>
+auto kernels_for() -> const span_kernels<T>&
+{
+#ifdef ANZU_HAS_AVX2_KERNELS
+    static const auto kernels = has_avx2() ? make_kernels<avx2_target, T>() : make_kernels<baseline_target, T>();
+#else
+    static const auto kernels = make_kernels<baseline_target, T>();
+#endif
+    return kernels;
+}
+
+template auto kernels_for<std::int32_t>() -> const span_kernels<std::int32_t>&;
+template auto kernels_for<std::int64_t>() -> const span_kernels<std::int64_t>&;
+template auto kernels_for<std::uint64_t>() -> const span_kernels<std::uint64_t>&;
+template auto kernels_for<double>() -> const span_kernels<double>&;
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace anzu {
+
+// Reductions and element-wise arithmetic over arrays of i32, i64, u64 or f64, used by the span
+// intrinsics. Integer arithmetic wraps. Reductions accumulate in a fixed number of lanes that
+// are combined at the end, so results are the same whichever instruction set is used. The
+// arrays are passed as bytes since VM memory may not be aligned for T, in which case a scalar
+// path is used instead.
+template <typename T>
+struct span_kernels
+{
+    auto (*sum)(const std::byte* data, std::size_t count) -> T;
+    auto (*min)(const std::byte* data, std::size_t count) -> T; // count must not be zero
+    auto (*max)(const std::byte* data, std::size_t count) -> T; // count must not be zero
+    auto (*count_eq)(const std::byte* data, std::size_t count, T value) -> std::uint64_t;
+    auto (*dot)(const std::byte* lhs, const std::byte* rhs, std::size_t count) -> T;
+    auto (*add)(std::byte* dst, const std::byte* lhs, const std::byte* rhs, std::size_t count) -> void;
+    auto (*mul)(std::byte* dst, const std::byte* lhs, const std::byte* rhs, std::size_t count) -> void;
+    auto (*scale)(std::byte* dst, const std::byte* src, T factor, std::size_t count) -> void;
+};
+
+// Returns the kernels for the widest instruction set that the CPU supports, which is checked
+// once, the first time that they are needed
+template <typename T>
+auto kernels_for() -> const span_kernels<T>&;
+
+extern template auto kernels_for<std::int32_t>() -> const span_kernels<std::int32_t>&;
+extern template auto kernels_for<std::int64_t>() -> const span_kernels<std::int64_t>&;
+extern template auto kernels_for<std::uint64_t>() -> const span_kernels<std::uint64_t>&;
+extern template auto kernels_for<double>() -> const span_kernels<double>&;
+
+}
@@ -0,0 +1,100 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <format>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define ANZU_HAS_GETRUSAGE
+#endif
+
+namespace anzu {
+namespace {
+
+auto json_string(std::string_view str) -> std::string
+{
+    auto ret = std::string{"\""};
+    for (const char c : str) {
+        switch (c) {
+            case '"':  ret += "\\\""; break;
+            case '\\': ret += "\\\\"; break;
+            case '\n': ret += "\\n"; break;
+            case '\t': ret += "\\t"; break;
+            default: {
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    ret += std::format("\\u{:04x}", static_cast<int>(c));
+                } else {
+                    ret += c;
+                }
+            } break;
+        }
+    }
+    ret += '"';
+    return ret;
+}
+
+template <typename T>
+auto json_optional(const std::optional<T>& value) -> std::string
+{
+    return value ? std::format("{}", *value) : std::string{"null"};
+}
+
+}
+
+auto peak_rss_bytes() -> std::optional<std::size_t>
+{
+#ifdef ANZU_HAS_GETRUSAGE
+    auto usage = rusage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return std::nullopt;
+#ifdef __APPLE__
+    return static_cast<std::size_t>(usage.ru_maxrss); // bytes
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#else
+    return std::nullopt;
+#endif
+}
+
+auto print_stats_json(const pipeline_stats& stats) -> void
+{
+    auto out = std::string{"{\n"};
+    out += std::format("  \"phases\": {{\"lex\": {}, \"parse\": {}, \"compile\": {}, \"run\": {}}},\n",
+                       json_optional(stats.lex_seconds),
+                       json_optional(stats.parse_seconds),
+                       json_optional(stats.compile_seconds),
+                       json_optional(stats.run_seconds));
+
+    out += "  \"modules\": [";
+    for (std::size_t i = 0; i != stats.modules.size(); ++i) {
+        const auto& mod = stats.modules[i];
+        out += std::format("{}\n    {{\"name\": {}, \"parse\": {}, \"compile\": {}}}",
+                           i == 0 ? "" : ",",
+                           json_string(mod.name),
+                           mod.parse_seconds,
+                           mod.compile_seconds);
+    }
+    out += stats.modules.empty() ? "],\n" : "\n  ],\n";
+
+    out += std::format("  \"template_instantiations\": {{\"functions\": {}, \"structs\": {}}},\n",
+                       stats.function_instantiations,
+                       stats.struct_instantiations);
+    out += std::format("  \"bytecode_bytes\": {},\n", stats.bytecode_bytes);
+    out += std::format("  \"rom_bytes\": {},\n", stats.rom_bytes);
+    if (stats.runtime) {
+        out += std::format("  \"runtime\": {{\"peak_stack_bytes\": {}, \"arenas_created\": {}, \"arena_peak_bytes\": {}}},\n",
+                           stats.runtime->peak_stack_bytes,
+                           stats.runtime->arenas_created,
+                           stats.runtime->arena_peak_bytes);
+    } else {
+        out += "  \"runtime\": null,\n";
+    }
+    out += std::format("  \"peak_rss_bytes\": {}\n", json_optional(peak_rss_bytes()));
+    out += "}\n";
+
+    std::fflush(stdout);
+    std::fputs(out.c_str(), stderr);
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "runtime.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace anzu {
+
+struct module_stats
+{
+    std::string name;
+    double      parse_seconds   = 0.0;
+    double      compile_seconds = 0.0;
+};
+
+// Everything reported by the --stats flag. Phases that did not run are left as nullopt.
+struct pipeline_stats
+{
+    std::optional<double> lex_seconds;
+    std::optional<double> parse_seconds;
+    std::optional<double> compile_seconds;
+    std::optional<double> run_seconds;
+
+    std::vector<module_stats> modules;
+
+    std::size_t function_instantiations = 0;
+    std::size_t struct_instantiations   = 0;
+    std::size_t bytecode_bytes          = 0;
+    std::size_t rom_bytes               = 0;
+
+    std::optional<runtime_stats> runtime;
+};
+
+// The peak resident set size of this process, if the platform can report it
+auto peak_rss_bytes() -> std::optional<std::size_t>;
+
+// Prints the statistics as a single JSON object to stderr, so that they are kept apart
+// from the output of the program
+auto print_stats_json(const pipeline_stats& stats) -> void;
+
+}
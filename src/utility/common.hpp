@@ -1,8 +1,11 @@
 #pragma once
+#include "error.hpp"
+
 #include <ranges>
 #include <format>
 #include <source_location>
 #include <chrono>
+#include <exception>
 #include <iostream>
 #include <print>
 
@@ -48,25 +51,25 @@ struct panic_format {
     std::source_location        loc;
 };
 
+// Throws an anzu::error, which the library entry points let propagate to the caller
 template <class... Args>
 [[noreturn]] auto panic(
     panic_format<std::type_identity_t<Args>...> fmt,
-    Args&&... args) noexcept -> void
+    Args&&... args) -> void
 {
-    print(
-        "{}:{} panic: {}\n",
+    throw error{std::format(
+        "{}:{} panic: {}",
         fmt.loc.file_name(),
         fmt.loc.line(),
         std::format(fmt.fmt, std::forward<Args>(args)...)
-    );
-    std::exit(1);
+    )};
 }
 
 template <class... Args>
 auto panic_if(
     bool condition,
     panic_format<std::type_identity_t<Args>...> fmt,
-    Args&&... args) noexcept -> void
+    Args&&... args) -> void
 {
     if (condition) {
         panic(fmt, std::forward<Args>(args)...);
@@ -87,12 +90,27 @@ struct scope_timer
     scope_timer() : start(clock_type::now()) {}
     ~scope_timer()
     {
+        if (std::uncaught_exceptions() > 0) return; // the program failed, the error is reported instead
         const auto duration = std::chrono::steady_clock::now() - start;
         const auto time_elapsed = std::chrono::duration_cast<second_type>(duration).count();
         std::print("\n -> Program took {} seconds\n", time_elapsed);
     }
 };
 
+// Measures the wall time since it was created
+struct stopwatch
+{
+    using clock_type = std::chrono::steady_clock;
+    using second_type = std::chrono::duration<double, std::ratio<1>>;
+
+    clock_type::time_point start = clock_type::now();
+
+    auto seconds() const -> double
+    {
+        return std::chrono::duration_cast<second_type>(clock_type::now() - start).count();
+    }
+};
+
 template <typename Callable>
 class scope_exit
 {
@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define ANZU_HAS_WRITEV
+#endif
+
+namespace anzu {
+
+// Writes to a file through a large buffer so that the file gets a few big writes however small
+// the pieces written are. Pieces too big for the buffer are written together with whatever is
+// already buffered in a single writev call, without being copied into the buffer first.
+class file_writer
+{
+    file_writer(const file_writer&) = delete;
+    file_writer& operator=(const file_writer&) = delete;
+
+#ifdef ANZU_HAS_WRITEV
+    int                     d_fd = -1;
+#else
+    std::FILE*              d_file = nullptr;
+#endif
+    std::unique_ptr<char[]> d_buffer;
+    std::size_t             d_capacity;
+    std::size_t             d_size = 0;
+    bool                    d_ok = true;
+
+    // Writes out the buffer followed by the given text
+    auto write_through(std::string_view text) -> void
+    {
+#ifdef ANZU_HAS_WRITEV
+        auto iov = std::array{
+            iovec{.iov_base = d_buffer.get(), .iov_len = d_size},
+            iovec{.iov_base = const_cast<char*>(text.data()), .iov_len = text.size()}
+        };
+        auto first = std::size_t{0};
+        while (d_ok && first != iov.size()) {
+            const auto written = ::writev(d_fd, &iov[first], static_cast<int>(iov.size() - first));
+            if (written < 0) {
+                d_ok = false;
+                break;
+            }
+            // Skip past whatever was written, which may have stopped part way through a piece
+            auto remaining = static_cast<std::size_t>(written);
+            while (first != iov.size() && remaining >= iov[first].iov_len) {
+                remaining -= iov[first].iov_len;
+                ++first;
+            }
+            if (first != iov.size()) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+                iov[first].iov_len -= remaining;
+            }
+        }
+#else
+        d_ok = d_ok && std::fwrite(d_buffer.get(), 1, d_size, d_file) == d_size;
+        d_ok = d_ok && std::fwrite(text.data(), 1, text.size(), d_file) == text.size();
+#endif
+        d_size = 0;
+    }
+
+public:
+    explicit file_writer(const std::string& path, std::size_t capacity = 1024 * 1024)
+        : d_buffer{std::make_unique_for_overwrite<char[]>(capacity)}
+        , d_capacity{capacity}
+    {
+#ifdef ANZU_HAS_WRITEV
+        d_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#else
+        d_file = std::fopen(path.c_str(), "wb");
+        if (d_file) std::setvbuf(d_file, nullptr, _IONBF, 0);
+#endif
+    }
+
+    ~file_writer() { close(); }
+
+    auto is_open() const -> bool
+    {
+#ifdef ANZU_HAS_WRITEV
+        return d_fd != -1;
+#else
+        return d_file != nullptr;
+#endif
+    }
+
+    // Returns false if anything written so far failed to reach the file
+    auto ok() const -> bool { return d_ok; }
+
+    auto write(std::string_view text) -> void
+    {
+        if (d_size + text.size() > d_capacity) {
+            write_through(text);
+            return;
+        }
+        std::memcpy(d_buffer.get() + d_size, text.data(), text.size());
+        d_size += text.size();
+    }
+
+    // Writes the value as std::format would with "{}"
+    template <typename T>
+    auto write_number(T value) -> void
+    {
+        auto chars = std::array<char, 32>{};
+        const auto [end, ec] = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+        write({chars.data(), end});
+    }
+
+    auto flush() -> void
+    {
+        if (is_open() && d_size > 0) write_through({});
+    }
+
+    // Flushes and closes the file, returning false if any of the output was lost
+    auto close() -> bool
+    {
+        if (!is_open()) return d_ok;
+        flush();
+#ifdef ANZU_HAS_WRITEV
+        d_ok = (::close(d_fd) == 0) && d_ok;
+        d_fd = -1;
+#else
+        d_ok = (std::fclose(d_file) == 0) && d_ok;
+        d_file = nullptr;
+#endif
+        return d_ok;
+    }
+};
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#define ANZU_HAS_POSIX_READ
+#endif
+
+namespace anzu {
+
+// Reads a file, or stdin, one line at a time through a fixed size buffer that is refilled with
+// large reads, so that files of any size can be processed in constant memory. The buffer only
+// grows if a single line does not fit in it. Reads return whatever is available, so lines
+// from a pipe or terminal are seen as soon as they arrive rather than once the buffer fills.
+class line_reader
+{
+    line_reader(const line_reader&) = delete;
+    line_reader& operator=(const line_reader&) = delete;
+
+#ifdef ANZU_HAS_POSIX_READ
+    int                     d_fd;
+#else
+    std::FILE*              d_file;
+#endif
+    bool                    d_owned;
+    std::unique_ptr<char[]> d_buffer;
+    std::size_t             d_capacity;
+    std::size_t             d_begin = 0; // start of the unread data in the buffer
+    std::size_t             d_end = 0;   // end of the unread data in the buffer
+    bool                    d_eof = false;
+    bool                    d_error = false;
+
+    // Moves the unread data to the front of the buffer and reads as much as fits after it
+    auto refill() -> void
+    {
+        if (d_begin == 0 && d_end == d_capacity) {
+            auto bigger = std::make_unique_for_overwrite<char[]>(d_capacity * 2);
+            std::memcpy(bigger.get(), d_buffer.get(), d_end);
+            d_buffer = std::move(bigger);
+            d_capacity *= 2;
+        } else if (d_begin != 0) {
+            std::memmove(d_buffer.get(), d_buffer.get() + d_begin, d_end - d_begin);
+            d_end -= d_begin;
+            d_begin = 0;
+        }
+#ifdef ANZU_HAS_POSIX_READ
+        auto count = ::read(d_fd, d_buffer.get() + d_end, d_capacity - d_end);
+        while (count < 0 && errno == EINTR) {
+            count = ::read(d_fd, d_buffer.get() + d_end, d_capacity - d_end);
+        }
+        if (count <= 0) {
+            d_eof = true;
+            d_error = count < 0;
+            return;
+        }
+        d_end += static_cast<std::size_t>(count);
+#else
+        const auto count = std::fread(d_buffer.get() + d_end, 1, d_capacity - d_end, d_file);
+        d_end += count;
+        if (count == 0) {
+            d_eof = true;
+            d_error = std::ferror(d_file) != 0;
+        }
+#endif
+    }
+
+public:
+    // A path of "-" reads from stdin
+    explicit line_reader(const std::string& path, std::size_t capacity = 1024 * 1024)
+#ifdef ANZU_HAS_POSIX_READ
+        : d_fd{path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY)}
+#else
+        : d_file{path == "-" ? stdin : std::fopen(path.c_str(), "rb")}
+#endif
+        , d_owned{path != "-"}
+        , d_buffer{std::make_unique_for_overwrite<char[]>(capacity)}
+        , d_capacity{capacity}
+    {
+#ifndef ANZU_HAS_POSIX_READ
+        // Reads go straight into our own buffer, so the stream does not need one too
+        if (d_file && d_owned) std::setvbuf(d_file, nullptr, _IONBF, 0);
+#endif
+    }
+
+    ~line_reader()
+    {
+#ifdef ANZU_HAS_POSIX_READ
+        if (d_fd != -1 && d_owned) ::close(d_fd);
+#else
+        if (d_file && d_owned) std::fclose(d_file);
+#endif
+    }
+
+    auto is_open() const -> bool
+    {
+#ifdef ANZU_HAS_POSIX_READ
+        return d_fd != -1;
+#else
+        return d_file != nullptr;
+#endif
+    }
+    auto has_error() const -> bool { return d_error; }
+
+    // Returns true if there is another line to read. This may refill the buffer, which
+    // invalidates the last line returned.
+    auto has_line() -> bool
+    {
+        if (d_begin == d_end && !d_eof) refill();
+        return d_begin != d_end;
+    }
+
+    // Returns the next line without its newline. The line is only valid until the next call
+    // to has_line or next_line, and is empty if there are no lines left.
+    auto next_line() -> std::string_view
+    {
+        auto newline = static_cast<const char*>(nullptr);
+        while (true) {
+            newline = static_cast<const char*>(std::memchr(d_buffer.get() + d_begin, '\n', d_end - d_begin));
+            if (newline || d_eof) break;
+            refill();
+        }
+        const auto start = d_buffer.get() + d_begin;
+        const auto end = newline ? newline : d_buffer.get() + d_end;
+        d_begin = newline ? static_cast<std::size_t>(newline - d_buffer.get()) + 1 : d_end;
+        return {start, static_cast<std::size_t>(end - start)};
+    }
+};
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ANZU_HAS_MMAP
+#endif
+
+namespace anzu {
+
+// A read-only view of the contents of a file that lives as long as the object. Where possible
+// the file is memory mapped so nothing is copied and pages are only read in once touched.
+// Files that cannot be mapped, such as pipes, are read into a buffer instead.
+class mapped_file
+{
+    const char*       d_data = nullptr;
+    std::size_t       d_size = 0;
+    bool              d_mapped = false;
+    std::vector<char> d_buffer = {};
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    auto release() -> void
+    {
+#ifdef ANZU_HAS_MMAP
+        if (d_mapped) munmap(const_cast<char*>(d_data), d_size);
+#endif
+        d_data = nullptr;
+        d_size = 0;
+        d_mapped = false;
+        d_buffer.clear();
+    }
+
+public:
+    mapped_file() = default;
+
+    mapped_file(mapped_file&& other) noexcept
+        : d_data{std::exchange(other.d_data, nullptr)}
+        , d_size{std::exchange(other.d_size, 0)}
+        , d_mapped{std::exchange(other.d_mapped, false)}
+        , d_buffer{std::move(other.d_buffer)}
+    {}
+
+    mapped_file& operator=(mapped_file&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            d_data = std::exchange(other.d_data, nullptr);
+            d_size = std::exchange(other.d_size, 0);
+            d_mapped = std::exchange(other.d_mapped, false);
+            d_buffer = std::move(other.d_buffer);
+        }
+        return *this;
+    }
+
+    ~mapped_file() { release(); }
+
+    // Returns false if the file could not be opened or read
+    auto open(const std::string& path) -> bool
+    {
+        release();
+#ifdef ANZU_HAS_MMAP
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) return false;
+        struct stat info = {};
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            const auto size = static_cast<std::size_t>(info.st_size);
+            const auto ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED) {
+                madvise(ptr, size, MADV_SEQUENTIAL);
+                d_data = static_cast<const char*>(ptr);
+                d_size = size;
+                d_mapped = true;
+                close(fd);
+                return true;
+            }
+        }
+        auto chunk = std::array<char, 64 * 1024>{};
+        auto count = ssize_t{0};
+        while ((count = read(fd, chunk.data(), chunk.size())) > 0) {
+            d_buffer.insert(d_buffer.end(), chunk.data(), chunk.data() + count);
+        }
+        close(fd);
+        if (count == -1) return false;
+#else
+        const auto handle = std::fopen(path.c_str(), "rb");
+        if (!handle) return false;
+        auto chunk = std::array<char, 64 * 1024>{};
+        while (const auto count = std::fread(chunk.data(), 1, chunk.size(), handle)) {
+            d_buffer.insert(d_buffer.end(), chunk.data(), chunk.data() + count);
+        }
+        const auto failed = std::ferror(handle);
+        std::fclose(handle);
+        if (failed) return false;
+#endif
+        d_data = d_buffer.data();
+        d_size = d_buffer.size();
+        return true;
+    }
+
+    auto data() const -> const char* { return d_data; }
+    auto size() const -> std::size_t { return d_size; }
+};
+
+}
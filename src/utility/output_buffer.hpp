@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace anzu {
+
+// Collects the output of programs so that stdout gets a few large writes rather than one for
+// every value printed. Output is passed on when the buffer fills up, on flush, and at exit,
+// as well as at the end of every line when stdout is a terminal so that it stays interactive.
+// Anything else writing to stdout must flush this first to keep the output in order.
+class output_buffer
+{
+    output_buffer(const output_buffer&) = delete;
+    output_buffer& operator=(const output_buffer&) = delete;
+
+    std::array<char, 64 * 1024> d_data;
+    std::size_t                 d_size = 0;
+    std::mutex                  d_mutex;
+    bool                        d_is_tty;
+
+    auto flush_locked() -> void
+    {
+        std::fwrite(d_data.data(), 1, d_size, stdout);
+        std::fflush(stdout);
+        d_size = 0;
+    }
+
+    auto write_locked(std::string_view text) -> void
+    {
+        if (d_size + text.size() > d_data.size()) {
+            flush_locked();
+            if (text.size() > d_data.size()) {
+                std::fwrite(text.data(), 1, text.size(), stdout);
+                return;
+            }
+        }
+        std::memcpy(d_data.data() + d_size, text.data(), text.size());
+        d_size += text.size();
+    }
+
+public:
+    output_buffer()
+#ifdef _WIN32
+        : d_is_tty{_isatty(_fileno(stdout)) != 0}
+#else
+        : d_is_tty{isatty(fileno(stdout)) != 0}
+#endif
+    {}
+
+    ~output_buffer() { flush(); }
+
+    auto flush() -> void
+    {
+        const auto lock = std::lock_guard{d_mutex};
+        flush_locked();
+    }
+
+    // Gives exclusive access to the buffer so that everything written through the writer
+    // stays together, even when other threads are printing too
+    class writer
+    {
+        output_buffer&              d_buffer;
+        std::lock_guard<std::mutex> d_lock;
+        bool                        d_newline = false;
+
+    public:
+        explicit writer(output_buffer& buffer) : d_buffer{buffer}, d_lock{buffer.d_mutex} {}
+
+        ~writer()
+        {
+            if (d_newline && d_buffer.d_is_tty) d_buffer.flush_locked();
+        }
+
+        auto write(std::string_view text) -> void
+        {
+            d_newline = d_newline || text.contains('\n');
+            d_buffer.write_locked(text);
+        }
+
+        // Writes the value as std::format would with "{}"
+        template <typename T>
+        auto write_number(T value) -> void
+        {
+            auto chars = std::array<char, 32>{};
+            const auto [end, ec] = std::to_chars(chars.data(), chars.data() + chars.size(), value);
+            d_buffer.write_locked({chars.data(), end});
+        }
+
+        // Writes the address as std::format would with "{:#018x}"
+        auto write_address(std::uint64_t value) -> void
+        {
+            auto chars = std::array<char, 18>{};
+            chars.fill('0');
+            chars[1] = 'x';
+            auto digits = std::array<char, 16>{};
+            const auto [end, ec] = std::to_chars(digits.data(), digits.data() + digits.size(), value, 16);
+            const auto count = static_cast<std::size_t>(end - digits.data());
+            std::memcpy(chars.data() + chars.size() - count, digits.data(), count);
+            d_buffer.write_locked({chars.data(), chars.size()});
+        }
+    };
+};
+
+// The buffer for everything printed by programs
+inline auto program_output() -> output_buffer&
+{
+    static auto buffer = output_buffer{};
+    return buffer;
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace anzu {
+
+// Redirects stdout to the null device for the lifetime of the object. This works at the
+// file descriptor level so that it also catches output that bypasses the C++ streams.
+class silence_stdout
+{
+    silence_stdout(const silence_stdout&) = delete;
+    silence_stdout& operator=(const silence_stdout&) = delete;
+
+    int d_saved = -1;
+
+public:
+    silence_stdout()
+    {
+        std::fflush(stdout);
+#ifdef _WIN32
+        const auto null_fd = _open("NUL", _O_WRONLY);
+        if (null_fd == -1) return;
+        d_saved = _dup(_fileno(stdout));
+        _dup2(null_fd, _fileno(stdout));
+        _close(null_fd);
+#else
+        const auto null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd == -1) return;
+        d_saved = dup(fileno(stdout));
+        dup2(null_fd, fileno(stdout));
+        close(null_fd);
+#endif
+    }
+
+    ~silence_stdout()
+    {
+        if (d_saved == -1) return;
+        std::fflush(stdout);
+#ifdef _WIN32
+        _dup2(d_saved, _fileno(stdout));
+        _close(d_saved);
+#else
+        dup2(d_saved, fileno(stdout));
+        close(d_saved);
+#endif
+    }
+};
+
+}